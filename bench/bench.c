@@ -0,0 +1,204 @@
+/*
+ * Microbenchmarks: compile-time of each pattern, and the time to find all matches of it (with re_find_next())
+ * in inputs of a few sizes, with each engine and the code of re_jit(). The patterns are those that make test checks against Python,
+ * plus a few that make matchstar() backtrack; the inputs are the text of tests/test2.c and a made-up log.
+ *
+ *   bench/bench [milliseconds per measurement, 50 by default]
+ *
+ * Prints a header and then a line per measurement, with tab-separated fields:
+ *
+ *   compile  pattern  -      -       0      -        -          ns/compile
+ *   match    pattern  input  engine  bytes  ns/byte  matches/s  -
+ *
+ * A backtracking search can take time polynomial in the length of the input. Going by how the time grew over
+ * the sizes before (quadratic to begin with), a search that would take more than MAX_SEARCH_TIME seconds is
+ * skipped, its ns/byte and matches/s printed as "-".
+ */
+
+#define _POSIX_C_SOURCE 199309L  /* clock_gettime() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "re.h"
+
+/* The text of tests/test2.c, in buf[], with its main() out of the way */
+#define main test2_main
+#include "../tests/test2.c"
+#undef main
+
+
+static const char* patterns[] =
+{
+  /* make test */
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "\\w*\\d?\\w\\?", "[^\\d]+\\\\?\\s", "[^\\w][^-1-4]", "[^\\w]", "[^1-4]",
+  "[^-1-4]", "[^\\d]+\\s?[\\w]*", "a+b*[ac]*.+.*.[\\.].", "a?b[ac*]*.?[\\]+[?]?", "[-1-5]+[-1-2]-[-]", "[-1-3]-[-]+",
+  "[1-5]+[-1-2]-[\\-]", "[-1-2]*", "\\s?[a-fKL098]+-?", "[\\-]*", "[\\\\]+", "[0-9a-fA-F]+", "[1379][2468][abcdef]",
+  "[012345-9]?[0123-789]", "[012345-9]", "[0-56789]", "[abc-zABC-Z]", "[a\\d]?1234", ".*123faerdig", ".?\\w+jsj",
+  "[?to][+to][?ta][*ta]", "\\d+", "[a-z]+", "\\w", "\\d", "[\\d]", "[^\\d]", "^\\w", "^\\d", "^[^\\d]", "[^\\w]+",
+  "^[\\w]+", "^[^0-9]", "[a-z].[A-Z]", "[-0-9]+", "[\\-]+",
+  /* tests/test2.c, and runs of '*' and '+' that backtrack into each other */
+  ".+nonexisting.+", "\\w*\\w*\\w*\\d", "[a-z]+[a-z]+[a-z]+q", ".*.*.*=", "ERROR \\d+", "\\d+ms$",
+};
+
+#define MAX_SEARCH_TIME  1.0
+
+/* The last is the backtracker running the code of re_jit() (built with RE_JIT, else the same as the first) */
+static const int engines[] = { RE_ENGINE_BACKTRACK, RE_ENGINE_PIKEVM, RE_ENGINE_BACKTRACK };
+static const char* enginenames[] = { "backtrack", "pikevm", "jit" };
+#define ENGINE_JIT  2
+static const int sizes[] = { 64, 1024, 1 << 16 };
+
+static char logtext[1 << 16];
+static double mintime;
+
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+/* Lines of a made-up log, with numbers and punctuation that the test2-text, all lowercase letters, doesn't have */
+static void makelog(void)
+{
+  size_t pos = 0;
+  int line = 0;
+
+  while (pos < sizeof(logtext) - 80)
+  {
+    const char* level = (line % 13 == 0) ? "ERROR" : ((line % 5 == 0) ? "WARN" : "INFO");
+    pos += (size_t) sprintf(logtext + pos, "2024-01-%02d 12:%02d:%02d [%s] req=%x took %dms\n",
+                            1 + line % 28, line % 60, (line * 7) % 60, level, line * 2654435761u, line % 997);
+    line += 1;
+  }
+  memset(logtext + pos, ' ', sizeof(logtext) - pos);
+}
+
+static void benchcompile(const char* pattern)
+{
+  static void* objects[1024];
+  double start = now();
+  double elapsed;
+  long n = 0;
+
+  do
+  {
+    int i;
+    for (i = 0; i < 100; ++i)
+    {
+      re_compile_into(pattern, objects, sizeof(objects));
+    }
+    n += 100;
+    elapsed = now() - start;
+  } while (elapsed < mintime);
+
+  printf("compile\t%s\t-\t-\t0\t-\t-\t%.1f\n", pattern, 1e9 * elapsed / (double) n);
+}
+
+/* Returns the time of one search through text */
+static double benchmatch(re_t re, const char* pattern, const char* input, const char* text, int length, int engine)
+{
+  double start;
+  double elapsed;
+  long matches = 0;
+  long n = 0;
+
+  re_set_engine(re, engines[engine]);
+  if (engine == ENGINE_JIT)
+  {
+    re_jit(re);
+  }
+  else
+  {
+    re_jit_free(re);
+  }
+  start = now();
+  do
+  {
+    int cursor = 0;
+    int matchstart;
+    int matchlength;
+
+    while (re_find_next(re, text, length, &cursor, &matchstart, &matchlength))
+    {
+      matches += 1;
+    }
+    n += 1;
+    elapsed = now() - start;
+  } while (elapsed < mintime);
+
+  printf("match\t%s\t%s\t%s\t%d\t%.3f\t%.0f\t-\n", pattern, input, enginenames[engine], length,
+         1e9 * elapsed / ((double) n * (double) length), (double) matches / elapsed);
+  fflush(stdout);
+  return elapsed / (double) n;
+}
+
+
+int main(int argc, char** argv)
+{
+  static void* objects[1024];
+  const char* inputs[] = { "test2", "log" };
+  const char* texts[2];
+  int npatterns = (int) (sizeof(patterns) / sizeof(*patterns));
+  int p;
+  int t;
+  int s;
+  int e;
+
+  mintime = 1e-3 * ((argc > 1) ? atof(argv[1]) : 50.0);
+  makelog();
+  texts[0] = buf;
+  texts[1] = logtext;
+
+  printf("bench\tpattern\tinput\tengine\tbytes\tns_per_byte\tmatches_per_s\tns_per_compile\n");
+  for (p = 0; p < npatterns; ++p)
+  {
+    re_t re = re_compile_into(patterns[p], objects, sizeof(objects));
+
+    benchcompile(patterns[p]);
+    for (t = 0; t < 2; ++t)
+    {
+      double searchtime[3] = { 0.0, 0.0, 0.0 };
+      double exponent[3] = { 2.0, 2.0, 2.0 };
+      int lastlength = 1;
+
+      for (s = 0; s < (int) (sizeof(sizes) / sizeof(*sizes)); ++s)
+      {
+        int length = sizes[s];
+
+        /* The test2-text is a little shorter than the largest size */
+        if ((t == 0) && (length > (int) sizeof(buf) - 1))
+        {
+          length = (int) sizeof(buf) - 1;
+        }
+        for (e = 0; e < (int) (sizeof(engines) / sizeof(*engines)); ++e)
+        {
+          const double growth = (double) length / (double) lastlength;
+          double time;
+
+          if (searchtime[e] * pow(growth, exponent[e]) > MAX_SEARCH_TIME)
+          {
+            printf("match\t%s\t%s\t%s\t%d\t-\t-\t-\n", patterns[p], inputs[t], enginenames[e], length);
+            searchtime[e] = 2.0 * MAX_SEARCH_TIME;
+            continue;
+          }
+          time = benchmatch(re, patterns[p], inputs[t], texts[t], length, e);
+          if ((searchtime[e] > 0.0) && (growth > 1.0))
+          {
+            exponent[e] = log(time / searchtime[e]) / log(growth);
+            exponent[e] = (exponent[e] < 1.0) ? 1.0 : exponent[e];
+          }
+          searchtime[e] = time;
+        }
+        lastlength = length;
+      }
+    }
+    re_jit_free(re);
+  }
+
+  return 0;
+}
@@ -29,14 +29,42 @@
 
 
 
+#if ((defined(RE_CACHE_SIZE) && (RE_CACHE_SIZE > 0)) || (defined(RE_THREADS) && (RE_THREADS > 0))) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L  /* pthread_rwlock_t, sysconf() */
+#endif
+
+#if defined(RE_JIT) && (RE_JIT > 0) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE  /* MAP_ANONYMOUS */
+#endif
+
 #include "re.h"
 #include <stdio.h>
-#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#if (RE_CACHE_SIZE > 0) || (RE_THREADS > 0)
+#include <pthread.h>
+#endif
+#if (RE_THREADS > 0)
+#include <unistd.h>
+#endif
+
+#if defined(RE_SIMD) && (RE_SIMD == 1) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(RE_JIT) && (RE_JIT == 1) && defined(__x86_64__) && defined(__GNUC__) && (defined(__linux__) || defined(__FreeBSD__))
+#define RE_JIT_X86_64
+#include <sys/mman.h>
+#endif
 
 /* Definitions: */
 
 #define MAX_REGEXP_OBJECTS      30    /* Max number of regex symbols in expression. */
-#define MAX_CHAR_CLASS_LEN      40    /* Max length of character-class buffer in.   */
+#define CCL_BITMAP_SIZE         32    /* Bytes per character-class: one bit per char. */
+#define MAX_LITERAL_LENGTH      16    /* Max number of chars kept of the literals that speed up searching. */
 
 
 enum { UNUSED, DOT, BEGIN, END, QUESTIONMARK, STAR, PLUS, CHAR, CHAR_CLASS, INV_CHAR_CLASS, DIGIT, NOT_DIGIT, ALPHA, NOT_ALPHA, WHITESPACE, NOT_WHITESPACE, /* BRANCH */ };
@@ -46,24 +74,450 @@ typedef struct regex_t
   unsigned char  type;   /* CHAR, STAR, etc.                      */
   union
   {
-    unsigned char  ch;   /*      the character itself             */
-    unsigned char* ccl;  /*  OR  a pointer to characters in class */
-  } u;
+    unsigned char        ch;   /*      the character itself             */
+    const unsigned char* ccl;  /*  OR  a pointer to the bitmap of chars */
+  } u;                         /*      in class, \d, \w, \s etc.        */
 } regex_t;
 
 
+/* Per-pattern data, kept in the first INFO_OBJECTS slots of the regex_t-array in front of the pattern. */
+typedef struct
+{
+  int  engine;           /* RE_ENGINE_BACKTRACK or RE_ENGINE_PIKEVM        */
+  int  nobjects;         /* number of objects, including the UNUSED-end    */
+  int  prefixlength;     /* number of chars in prefix                      */
+  int  requiredlength;   /* number of chars in required, 0 if only prefix  */
+  char prefix[MAX_LITERAL_LENGTH];   /* literal chars every match starts with */
+  char required[MAX_LITERAL_LENGTH]; /* longest literal every match contains  */
+  int  firstknown;       /* not every byte can start a match               */
+  unsigned char first[CCL_BITMAP_SIZE]; /* bitmap of bytes a match can start with */
+  int  endanchored;      /* ends with '$' but doesn't start with '^'       */
+  void*  jitcode;        /* code of re_jit(), or NULL                      */
+  size_t jitsize;        /* bytes mapped for it                            */
+} re_info_t;
+
+#define INFO_OBJECTS  ((sizeof(re_info_t) + sizeof(regex_t) - 1) / sizeof(regex_t))
+
+
+/* Work a search may still do, see re_matchpn_budget(). Steps are counted down in rounds of up to MATCH_ROUND_STEPS,
+   after which the budget and the cancel-flag are looked at. Once either runs out, every further step fails, so the
+   matchers unwind as if nothing matched, and the caller finds stopped set.
+   Whether matchpattern() matches only depends on the object and text-offset it starts at, so re_matchpn_memo()
+   has it set a bit for the two when it fails, and fail right away when it finds the bit set. */
+#define MATCH_ROUND_STEPS  1024
+
+typedef struct
+{
+  unsigned long        countdown;  /* steps left in this round                    */
+  unsigned long        left;       /* steps left after this round, if limited     */
+  const volatile int*  cancel;     /* give up once *cancel is set, if not NULL   */
+  int                  limited;
+  int                  stopped;    /* budget exceeded or cancelled               */
+  unsigned char*       memo;       /* bit per offset and object that failed, or NULL */
+  const regex_t*       memobase;   /* object 0                                   */
+  const char*          memotext;   /* offset 0                                   */
+  size_t               memolength; /* offsets that memo has room for             */
+  size_t               memostride; /* objects per offset                         */
+#if (RE_STATS > 0)
+  unsigned long        depth;      /* quantifiers being matched, each a matchpattern() call deeper */
+  re_match_stats_t     stats;
+#endif
+} matcher_t;
+
+/* Counting for re_matchpn_stats() and re_find_next_stats(), left out unless RE_STATS is set.
+   STAT_SCAN counts the bytes a prefilter looked through from from on: up to the end of its hit, or of the text. */
+#if (RE_STATS > 0)
+#define STAT_ADD(m, counter, n)  ((m)->stats.counter += (unsigned long) (n))
+#define STAT_SCAN(m, from, hit, length, end)  STAT_ADD(m, scanned, (((hit) != 0) ? ((hit) + (length)) : (end)) - (from))
+#define STARTLENGTH(pinfo)       (((pinfo)->prefixlength > 0) ? (pinfo)->prefixlength : ((pinfo)->firstknown != 0))
+#define STAT_CALL(m)             ((m)->stats.matchpatterns++, ((m)->depth >= (m)->stats.maxdepth) ? ((m)->stats.maxdepth = (m)->depth + 1) : 0)
+#define STAT_ENTER(m)            ((m)->depth++)
+#define STAT_LEAVE(m)            ((m)->depth--)
+#else
+#define STAT_ADD(m, counter, n)  ((void) 0)
+#define STAT_SCAN(m, from, hit, length, end)  ((void) 0)
+#define STAT_CALL(m)             ((void) 0)
+#define STAT_ENTER(m)            ((void) 0)
+#define STAT_LEAVE(m)            ((void) 0)
+#endif
+
+
+/* JIT: re_jit() turns each place matchpattern() can be started from into an x86-64 function
+   int f(const char* text, const char* end, int* matchlength), with the same result. They form a chain:
+   a function matches its objects a char at a time up to the first one with a quantifier, and calls the
+   next function for the rest of the pattern after it, just like matchpattern() recurses. The code is
+   emitted twice, first only to count its bytes, then into the mapped page. */
+#ifdef RE_JIT_X86_64
+typedef int (*jitmatch_t)(const char* text, const char* end, int* matchlength);
+
+typedef struct
+{
+  unsigned char* code;      /* where the code goes, NULL while counting its bytes    */
+  size_t         size;      /* bytes emitted so far                                  */
+  size_t         calls[2];  /* calls of the next function, to patch once it begins   */
+  int            ncalls;
+} jit_t;
+#endif
+
+
+/* Lazy DFA: a DFA-state is the list of Pike VM thread-states at a text position, in priority order,
+   without the start-offsets. Unanchored patterns get a START item at the end of the list, standing for
+   the thread the Pike VM starts at every position until it has found a match. The list is cut after
+   the first matched thread, just like the Pike VM cuts off lower priority threads.
+   Running the states over the text finds where the match ends; a backwards pass finds where it starts. */
+#define DFA_NOSTATE       (-1)  /* transition not built yet                                    */
+#define DFA_MIN_BYTES     10    /* bytes per cached state below which steps aren't cached     */
+#define DFA_BUCKET_BYTES  64    /* bytes of the cache per hash-bucket                          */
+
+typedef struct
+{
+  int  nitems;
+  int  matched;   /* the list holds a matched thread (its last item) */
+  int  hash;
+  int  chain;     /* next state in the hash-bucket                   */
+  int  next[1];   /* nclasses transitions, followed by nitems items  */
+} dfastate_t;
+
+/* States take as much room as their items need and are laid out one after the other, like those of sets */
+struct re_dfa
+{
+  regex_t*       pattern;
+  int            nobjects;
+  int            nclasses;
+  int            nbuckets;
+  int            cachesize;
+  int            cacheused;
+  int            nstates;      /* states in the cache                            */
+  int            since_flush;  /* bytes matched since the cache was last flushed */
+  int*           buckets;      /* offset of the first state in each hash-bucket  */
+  unsigned char* cache;
+  unsigned char  classmap[256]; /* bytes that no object tells apart share a class */
+};
+
+
+/* Pattern sets: a lazy DFA over the Pike VM thread-states of all patterns at once, numbered one pattern
+   after the other. Only whether a pattern matches is of interest, not where, so a DFA-state is a sorted
+   set of them. The start-states of unanchored patterns join at every position but the end of the text
+   and are left out of the DFA-states. States vary in size and are laid out one after the other.
+   Patterns that are nothing but a string of chars skip the DFA: an Aho-Corasick automaton finds them all.
+   Its nodes are numbered breadth-first, so the children of a node are the consecutive nodes from
+   acfirst[node] to acfirst[node + 1], in order of the byte that leads to them. */
+#define SET_BUCKETS       1024  /* hash-buckets of the DFA-state cache */
+#define ALIGNED(n)        ((((n) + sizeof(void*) - 1) / sizeof(void*)) * sizeof(void*))
+
+typedef struct
+{
+  regex_t*  literal;
+  int       id;       /* index of the pattern                          */
+  int       node;     /* node of the part of literal added to the trie, -1 once all of it is */
+} setliteral_t;
+
+typedef struct
+{
+  int  nitems;
+  int  nmatched;  /* number of patterns with a matched item                   */
+  int  natend;    /* number of patterns with an item that matches at the end  */
+  int  hash;
+  int  chain;     /* next state in the hash-bucket                            */
+  int  reported;  /* generation of the last match that recorded its matches   */
+  int  next[1];   /* nclasses transitions, nitems items, nmatched + natend patterns */
+} setstate_t;
+
+struct re_set
+{
+  int             npatterns;
+  int             nstates;      /* thread-states of all patterns                           */
+  int             nclasses;
+  int             nunanchored;
+  int             nempty;
+  int             nliterals;    /* patterns left to the Aho-Corasick automaton             */
+  int             nnodes;
+  int             stamp;
+  int             generation;   /* number of matches so far                                */
+  int             start;        /* state at the start of the text, DFA_NOSTATE if not built */
+  int             cachesize;
+  int             cacheused;
+  regex_t**       patterns;
+  int*            base;         /* first thread-state of each pattern                      */
+  int*            owner;        /* pattern of each thread-state                            */
+  int*            mark;         /* mark[state] == stamp if state is in the list being built */
+  int*            items;        /* the list being built                                    */
+  int*            unanchored;   /* start-states of the unanchored patterns                 */
+  int*            empty;        /* unanchored patterns that match the empty string         */
+  unsigned char*  found;        /* found[i] is set once pattern i has matched              */
+  setliteral_t*   literals;     /* the literal patterns, sorted                            */
+  int*            acfirst;      /* first child of each node                                */
+  int*            acfail;       /* node of the longest proper suffix in the trie           */
+  int*            acout;        /* first pattern that ends at each node, or -1             */
+  int*            acdict;       /* next node on the acfail-chain with a pattern, or -1     */
+  int*            acreported;   /* generation of the last match that recorded the node     */
+  int*            acnext;       /* next pattern with the same literal, or -1               */
+  unsigned char*  acbyte;       /* byte leading to each node                               */
+  unsigned char*  cache;
+  int             buckets[SET_BUCKETS];
+  int             acroot[256];  /* children of the root, 0 for bytes without one           */
+  unsigned char   classmap[256];
+  unsigned char   classrep[256]; /* a byte of each class */
+};
+
+
+/* Streams: the Pike VM, with its thread-lists kept from one piece of text to the next. Threads carry the offset
+   they started at, so no text is kept unless a match has been found while threads of a higher priority still run:
+   once they have died out, the search goes on from the end of the match, which needs the text since then. */
+struct re_stream
+{
+  regex_t*              pattern;
+  re_stream_callback_t  callback;
+  void*                 context;
+  int                   nobjects;
+  int                   nthreads;     /* threads in the current list                         */
+  int                   current;      /* which of the lists is current                       */
+  int                   stamp;        /* visited-stamp the current list was built with       */
+  int                   searching;    /* 0 once an anchored pattern has had its one chance   */
+  int                   pending;      /* a match has been found, but may still be beaten     */
+  int                   failed;       /* the text since the match didn't fit                 */
+  int                   nmatches;     /* matches reported by this call                       */
+  size_t                pos;          /* offset of the next byte to run the threads over     */
+  size_t                total;        /* bytes fed so far                                    */
+  size_t                matchstart;
+  size_t                matchend;
+  size_t                histstart;    /* offset of the first byte kept                       */
+  size_t                histlength;
+  size_t                histsize;
+  int*                  visited;
+  int*                  state[2];
+  size_t*               start[2];
+  char*                 history;
+};
+
+
+#if (RE_THREADS > 0)
+/* Batches: each thread starts out with a range of the texts of its own, which it works through from the front.
+   Once that is done, it steals the back half of the range of another thread. A range is one 64-bit word,
+   first << 32 | end, so taking from either side is a single compare-and-swap. */
+#define BATCH_CHUNK        64     /* texts a thread takes from its own range at a time             */
+#define BATCH_MAX_THREADS  256
+#define BATCH_TEXT_BYTES   32     /* what a text costs to match on top of its bytes, counted in bytes */
+#define BATCH_THREAD_BYTES 65536  /* work below which a thread costs more to start than it saves      */
+
+typedef struct
+{
+  unsigned long long  range;
+  char                pad[64 - sizeof(unsigned long long)];  /* a cache-line per range */
+} batchrange_t;
+
+typedef struct
+{
+  regex_t*       pattern;
+  const char**   texts;
+  const int*     lengths;
+  int*           results;
+  int            nworkers;
+  int            matched;      /* texts matched, summed up by the threads as they finish */
+  batchrange_t*  ranges;
+} batch_t;
+
+typedef struct
+{
+  batch_t*  batch;
+  int       self;
+} batchworker_t;
+#endif
+
+
+/* Scans: the buffer is cut into pieces of whole lines, which the threads take in order. A thread reports the
+   matches of its piece as they are found once the pieces before it are done; until then it holds them back in a
+   list on the heap that grows as needed, and never waits. Whichever thread finishes the piece whose turn it is
+   reports the pieces after it that are done too, so the callback is called from one thread at a time. */
+#define SCAN_PIECE     65536  /* smallest piece of the buffer a thread takes at a time */
+#define SCAN_HELD      64     /* matches a piece first makes room for, when it has to hold them back */
+
+typedef struct
+{
+  size_t  linestart;
+  size_t  linelength;
+  size_t  matchstart;
+  size_t  matchlength;
+} scanmatch_t;
+
+typedef struct
+{
+  scanmatch_t*  held;      /* matches held back until the pieces before are reported, from malloc() */
+  size_t        nheld;
+  size_t        capacity;
+  int           done;      /* matched all of its lines                                              */
+} scanpiece_t;
+
+typedef struct
+{
+  regex_t*            pattern;
+  const char*         buf;
+  size_t              len;
+  size_t              piecesize;
+  size_t              npieces;
+  re_scan_callback_t  callback;
+  void*               context;
+  size_t              next;       /* next piece to take                     */
+  size_t              turn;       /* piece whose matches are reported next  */
+  size_t              matched;
+  scanpiece_t*        pieces;     /* per piece, NULL with a single thread   */
+  int                 reporting;  /* a thread reports the pieces done       */
+#if (RE_THREADS > 0)
+  pthread_mutex_t     lock;
+  pthread_cond_t      turned;
+#endif
+} scan_t;
+
+
+#if (RE_CACHE_SIZE > 0)
+/* Pattern-cache of re_match(): compiled patterns keyed by their string, chained in hash-buckets.
+   Lookups share the lock, so many threads can match at once; compiling a missing pattern takes it alone. */
+#define CACHE_PATTERN_LENGTH    128   /* Longer patterns are compiled on every call. */
+#define CACHE_BUCKETS           (2 * RE_CACHE_SIZE)
+
+typedef struct
+{
+  regex_t        objects[INFO_OBJECTS + MAX_REGEXP_OBJECTS];
+  unsigned char  ccl_buf[MAX_REGEXP_OBJECTS * CCL_BITMAP_SIZE];
+  char           pattern[CACHE_PATTERN_LENGTH];
+  unsigned int   hash;
+  int            next;      /* next entry in the bucket + 1, or 0 */
+  int            valid;     /* compiled into objects            */
+  unsigned long  used;      /* tick of the last lookup, for LRU */
+} cache_entry_t;
+
+static pthread_rwlock_t cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct
+{
+  cache_entry_t     entries[RE_CACHE_SIZE];
+  int               buckets[CACHE_BUCKETS];  /* first entry in the bucket + 1, or 0 */
+  int               nentries;
+  unsigned long     tick;
+  re_cache_stats_t  stats;
+} cache;
+#endif
+
+
+/* Membership bitmaps for the meta-classes: bit ((c >> 4) & 7) of byte ((c & 15) | ((c >> 3) & 16)) is set if
+   c is in the class. Split up by the nibbles of c, the bitmap can be tested 16 or 32 bytes at a time with SIMD. */
+static const unsigned char digit_bitmap[CCL_BITMAP_SIZE] =          /* [0-9]          */
+{
+  0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+static const unsigned char not_digit_bitmap[CCL_BITMAP_SIZE] =
+{
+  0xf7, 0xf7, 0xf7, 0xf7, 0xf7, 0xf7, 0xf7, 0xf7, 0xf7, 0xf7, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+static const unsigned char alpha_bitmap[CCL_BITMAP_SIZE] =          /* [a-zA-Z0-9_]   */
+{
+  0xa8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf8, 0xf0, 0x50, 0x50, 0x50, 0x50, 0x70,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+static const unsigned char not_alpha_bitmap[CCL_BITMAP_SIZE] =
+{
+  0x57, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x0f, 0xaf, 0xaf, 0xaf, 0xaf, 0x8f,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+static const unsigned char whitespace_bitmap[CCL_BITMAP_SIZE] =     /* [ \t\n\v\f\r]   */
+{
+  0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+static const unsigned char not_whitespace_bitmap[CCL_BITMAP_SIZE] =
+{
+  0xfb, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+
 
 /* Private function declarations: */
-static int matchpattern(regex_t* pattern, const char* text, int* matchlength);
-static int matchcharclass(char c, const char* str);
-static int matchstar(regex_t p, regex_t* pattern, const char* text, int* matchlength);
-static int matchplus(regex_t p, regex_t* pattern, const char* text, int* matchlength);
+static int compile(const char* pattern, regex_t* re_compiled, int max_objects, unsigned char* ccl_buf, int* nobjects, int* nclasses);
+static re_info_t* info(re_t pattern);
+#if (RE_CACHE_SIZE > 0)
+static int matchcached(const char* pattern, const char* text, int textlength, int* matchlength);
+static cache_entry_t* cachelookup(const char* pattern, unsigned int hash);
+#endif
+static int literalprefix(const regex_t* pattern, char* prefix);
+static int requiredliteral(const regex_t* pattern, char* required);
+static int firstbytes(const regex_t* pattern, unsigned char* bitmap);
+static const char* findliteral(const char* literal, int length, const char* text, const char* end);
+static const char* findstart(const re_info_t* pinfo, const char* text, const char* end);
+static void matcherinit(matcher_t* m, unsigned long maxsteps, const volatile int* cancel);
+static int matchsteps(matcher_t* m, unsigned long n);
+static int matchround(matcher_t* m, unsigned long n);
+static int matchtext(regex_t* pattern, const char* text, int textlength, int* matchlength, matcher_t* m);
+static int findnext(regex_t* pattern, const char* text, int textlength, int* cursor, int* matchstart, int* matchlength, matcher_t* m);
+static int memoized(const matcher_t* m, const regex_t* pattern, const char* text);
+static void memoize(matcher_t* m, const regex_t* pattern, const char* text);
+static int matchpattern(regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m);
+static int matchpikevm(regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m);
+static int matchbackward(regex_t* pattern, const char* text, int textlength, int matchend, matcher_t* m);
+static int matchdfa(struct re_dfa* dfa, const char* text, int textlength, int* matchlength);
+static void dfaflush(struct re_dfa* dfa);
+static size_t setsize(const char** patterns, int npatterns, int* nstates, int* nnodes);
+static int matchset(struct re_set* set, const char* text, int textlength, int* ids);
+static int isliteral(const regex_t* pattern);
+static void setbuildliterals(struct re_set* set);
+static void setscanliterals(struct re_set* set, const char* text, int textlength, int* ids, int* nfound);
+static void setflush(struct re_set* set);
+static void setnewlist(struct re_set* set);
+static void setaddstate(struct re_set* set, int p, int state, int* nitems);
+static int setmatched(struct re_set* set, int item, int atend);
+static void setfound(struct re_set* set, int p, int* ids, int* nfound);
+static int matchbatch(regex_t* pattern, const char** texts, const int* lengths, int first, int end, int* results);
+#if (RE_THREADS > 0)
+static int batchthreads(const char** texts, const int* lengths, int n, int nthreads);
+static void* batchworker(void* arg);
+static int batchtake(batchrange_t* range, int count, int* first, int* end);
+static int batchsteal(batch_t* batch, int self);
+#endif
+static void scanpieces(scan_t* scan);
+static size_t scanlinestart(const scan_t* scan, size_t offset);
+static size_t scantake(scan_t* scan);
+static int scanisturn(scan_t* scan, size_t piece);
+static int scanhold(scan_t* scan, size_t piece, const scanmatch_t* match);
+static void scanreport(scan_t* scan, size_t piece);
+static void scanwait(scan_t* scan, size_t piece);
+static void scandone(scan_t* scan, size_t piece, size_t matched);
+#if (RE_THREADS > 0)
+static void* scanworker(void* arg);
+#endif
+static void streamstep(struct re_stream* stream, int c);
+static void streamreport(struct re_stream* stream);
+static void streamrun(struct re_stream* stream);
+static int matchcharclass(char c, const char* str, const char* end);
+static int matchfirst(const re_info_t* pinfo, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m);
+#ifdef RE_JIT_X86_64
+static void jitpattern(jit_t* jit, regex_t* pattern);
+static int jitentry(jit_t* jit, regex_t* pattern, int i);
+static void jittest(jit_t* jit, regex_t p, size_t miss);
+static long jitrun(const regex_t* p, const char* text, const char* end);
+static int jitmatchesall(regex_t p);
+static void jitemit(jit_t* jit, const char* bytes, size_t n);
+static void jitimm(jit_t* jit, unsigned long long value, size_t n);
+static void jitjump(jit_t* jit, const char* op, size_t target);
+static size_t jitforward(jit_t* jit, const char* op);
+static void jitland(jit_t* jit, size_t at);
+#endif
+static int matchstar(regex_t p, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m);
+static int matchplus(regex_t p, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m);
 static int matchone(regex_t p, char c);
+static int matchbitmap(const unsigned char* bitmap, char c);
+static void setbitmap(unsigned char* bitmap, char c);
+static int matchrun(regex_t p, const char* text, const char* end);
+#ifdef RE_SIMD_X86
+static const char* matchrunsimd(regex_t p, const char* text, const char* end);
+static const char* matchrunssse3(const unsigned char* bitmap, const char* text, const char* end);
+static const char* matchrunavx2(const unsigned char* bitmap, const char* text, const char* end);
+#endif
 static int matchdigit(char c);
-static int matchalpha(char c);
+static int matchalphanum(char c);
 static int matchwhitespace(char c);
 static int matchmetachar(char c, const char* str);
-static int matchrange(char c, const char* str);
+static int matchrange(char c, const char* str, const char* end);
 static int matchdot(char c);
 static int ismetachar(char c);
 
@@ -72,457 +526,3631 @@ static int ismetachar(char c);
 /* Public functions: */
 int re_match(const char* pattern, const char* text, int* matchlength)
 {
+#if (RE_CACHE_SIZE > 0)
+  return matchcached(pattern, text, (int) strlen(text), matchlength);
+#else
   return re_matchp(re_compile(pattern), text, matchlength);
+#endif
 }
 
 int re_matchp(re_t pattern, const char* text, int* matchlength)
 {
-  *matchlength = 0;
-  if (pattern != 0)
+  return re_matchpn(pattern, text, (int) strlen(text), matchlength);
+}
+
+int re_matchn(const char* pattern, const char* text, int textlength, int* matchlength)
+{
+#if (RE_CACHE_SIZE > 0)
+  return matchcached(pattern, text, textlength, matchlength);
+#else
+  return re_matchpn(re_compile(pattern), text, textlength, matchlength);
+#endif
+}
+
+int re_matchpn(re_t pattern, const char* text, int textlength, int* matchlength)
+{
+  matcher_t m;
+
+  matcherinit(&m, 0, 0);
+  return matchtext(pattern, text, textlength, matchlength, &m);
+}
+
+int re_matchp_budget(re_t pattern, const char* text, int* matchlength, unsigned long maxsteps, const volatile int* cancel)
+{
+  return re_matchpn_budget(pattern, text, (int) strlen(text), matchlength, maxsteps, cancel);
+}
+
+int re_matchpn_budget(re_t pattern, const char* text, int textlength, int* matchlength, unsigned long maxsteps, const volatile int* cancel)
+{
+  matcher_t m;
+  int idx;
+
+  matcherinit(&m, maxsteps, cancel);
+  idx = matchtext(pattern, text, textlength, matchlength, &m);
+  if (m.stopped)
   {
-    if (pattern[0].type == BEGIN)
-    {
-      return ((matchpattern(&pattern[1], text, matchlength)) ? 0 : -1);
-    }
-    else
-    {
-      int idx = -1;
+    *matchlength = 0;
+    return RE_BUDGET_EXCEEDED;
+  }
+  return idx;
+}
 
-      do
-      {
-        idx += 1;
+int re_matchpn_stats(re_t pattern, const char* text, int textlength, int* matchlength, re_match_stats_t* stats)
+{
+  matcher_t m;
+  int idx;
 
-        if (matchpattern(pattern, text, matchlength))
-        {
-          if (text[0] == '\0')
-            return -1;
+  matcherinit(&m, 0, 0);
+  idx = matchtext(pattern, text, textlength, matchlength, &m);
+#if (RE_STATS > 0)
+  *stats = m.stats;
+#else
+  memset(stats, 0, sizeof(*stats));
+#endif
+  return idx;
+}
 
-          return idx;
-        }
-      }
-      while (*text++ != '\0');
+size_t re_memo_size(re_t pattern, int textlength)
+{
+  if (pattern == 0)
+  {
+    return 0;
+  }
+  return ((size_t) (textlength + 1) * (size_t) info(pattern)->nobjects + 7) / 8;
+}
+
+int re_matchpn_memo(re_t pattern, const char* text, int textlength, int* matchlength, void* memo, size_t memosize)
+{
+  matcher_t m;
+
+  matcherinit(&m, 0, 0);
+  if ((pattern != 0) && (memo != 0))
+  {
+    m.memostride = (size_t) info(pattern)->nobjects;
+    m.memolength = 8 * memosize / m.memostride;
+    if (m.memolength > (size_t) textlength + 1)
+    {
+      m.memolength = (size_t) textlength + 1;
     }
+    memset(memo, 0, (m.memolength * m.memostride + 7) / 8);
+    m.memo = (unsigned char*) memo;
+    m.memobase = pattern;
+    m.memotext = text;
   }
-  return -1;
+  return matchtext(pattern, text, textlength, matchlength, &m);
 }
 
 re_t re_compile(const char* pattern)
 {
   /* The sizes of the two static arrays below substantiates the static RAM usage of this module.
-     MAX_REGEXP_OBJECTS is the max number of symbols in the expression.
-     MAX_CHAR_CLASS_LEN determines the size of buffer for chars in all char-classes in the expression. */
-  static regex_t re_compiled[MAX_REGEXP_OBJECTS];
-  static unsigned char ccl_buf[MAX_CHAR_CLASS_LEN];
-  int ccl_bufidx = 1;
+     MAX_REGEXP_OBJECTS - 1 is the max number of symbols in the expression; longer ones don't compile.
+     Every symbol may be a character-class, so ccl_buf has room for a bitmap per symbol. */
+  static regex_t re_compiled[INFO_OBJECTS + MAX_REGEXP_OBJECTS];
+  static unsigned char ccl_buf[MAX_REGEXP_OBJECTS * CCL_BITMAP_SIZE];
 
-  char c;     /* current char in pattern   */
-  int i = 0;  /* index into pattern        */
-  int j = 0;  /* index into re_compiled    */
+  if (!compile(pattern, &re_compiled[INFO_OBJECTS], MAX_REGEXP_OBJECTS, ccl_buf, 0, 0))
+  {
+    return 0;
+  }
+  return (re_t) &re_compiled[INFO_OBJECTS];
+}
+
+size_t re_compiled_size(const char* pattern)
+{
+  int nobjects;
+  int nclasses;
 
-  while (pattern[i] != '\0' && (j+1 < MAX_REGEXP_OBJECTS))
+  if (!compile(pattern, 0, RE_MAX_SYMBOLS + 1, 0, &nobjects, &nclasses))
   {
-    c = pattern[i];
+    return 0;
+  }
+  return ((INFO_OBJECTS + nobjects) * sizeof(regex_t)) + (nclasses * CCL_BITMAP_SIZE);
+}
 
-    switch (c)
-    {
-      /* Meta-characters: */
-      case '^': {    re_compiled[j].type = BEGIN;           } break;
-      case '$': {    re_compiled[j].type = END;             } break;
-      case '.': {    re_compiled[j].type = DOT;             } break;
-      case '*': {    re_compiled[j].type = STAR;            } break;
-      case '+': {    re_compiled[j].type = PLUS;            } break;
-      case '?': {    re_compiled[j].type = QUESTIONMARK;    } break;
-/*    case '|': {    re_compiled[j].type = BRANCH;          } break; <-- not working properly */
+re_t re_compile_into(const char* pattern, void* buf, size_t bufsize)
+{
+  int nobjects;
+  int nclasses;
+  regex_t* objects = (regex_t*) buf;
 
-      /* Escaped character-classes (\s \w ...): */
-      case '\\':
-      {
-        if (pattern[i+1] != '\0')
-        {
-          /* Skip the escape-char '\\' */
-          i += 1;
-          /* ... and check the next */
-          switch (pattern[i])
-          {
-            /* Meta-character: */
-            case 'd': {    re_compiled[j].type = DIGIT;            } break;
-            case 'D': {    re_compiled[j].type = NOT_DIGIT;        } break;
-            case 'w': {    re_compiled[j].type = ALPHA;            } break;
-            case 'W': {    re_compiled[j].type = NOT_ALPHA;        } break;
-            case 's': {    re_compiled[j].type = WHITESPACE;       } break;
-            case 'S': {    re_compiled[j].type = NOT_WHITESPACE;   } break;
+  /* Dry run first: the buffer must hold the info, every object and the class-bitmaps behind them. */
+  if (    (buf == 0)
+       || !compile(pattern, 0, RE_MAX_SYMBOLS + 1, 0, &nobjects, &nclasses)
+       || (bufsize < ((INFO_OBJECTS + nobjects) * sizeof(regex_t)) + (nclasses * CCL_BITMAP_SIZE)))
+  {
+    return 0;
+  }
+  objects += INFO_OBJECTS;
+  if (!compile(pattern, objects, nobjects, (unsigned char*) &objects[nobjects], 0, 0))
+  {
+    return 0;
+  }
+  return (re_t) objects;
+}
 
-            /* Escaped character, e.g. '.' or '$' */
-            default:
-            {
-              re_compiled[j].type = CHAR;
-              re_compiled[j].u.ch = pattern[i];
-            } break;
-          }
-        }
-        /* '\\' as last char in pattern -> invalid regular expression. */
-/*
-        else
-        {
-          re_compiled[j].type = CHAR;
-          re_compiled[j].ch = pattern[i];
-        }
-*/
-      } break;
+void re_set_engine(re_t pattern, int engine)
+{
+  if (pattern != 0)
+  {
+    info(pattern)->engine = engine;
+  }
+}
 
-      /* Character class: */
-      case '[':
-      {
-        /* Remember where the char-buffer starts. */
-        int buf_begin = ccl_bufidx;
+int re_jit(re_t pattern)
+{
+#ifdef RE_JIT_X86_64
+  jit_t jit;
+  void* code;
 
-        /* Look-ahead to determine if negated */
-        if (pattern[i+1] == '^')
-        {
-          re_compiled[j].type = INV_CHAR_CLASS;
-          i += 1; /* Increment i to avoid including '^' in the char-buffer */
-          if (pattern[i+1] == 0) /* incomplete pattern, missing non-zero char after '^' */
-          {
-            return 0;
-          }
-        }
-        else
-        {
-          re_compiled[j].type = CHAR_CLASS;
-        }
+  if (pattern == 0)
+  {
+    return 0;
+  }
+  re_jit_free(pattern);
 
-        /* Copy characters inside [..] to buffer */
-        while (    (pattern[++i] != ']')
-                && (pattern[i]   != '\0')) /* Missing ] */
-        {
-          if (pattern[i] == '\\')
-          {
-            if (ccl_bufidx >= MAX_CHAR_CLASS_LEN - 1)
-            {
-              //fputs("exceeded internal buffer!\n", stderr);
-              return 0;
-            }
-            if (pattern[i+1] == 0) /* incomplete pattern, missing non-zero char after '\\' */
-            {
-              return 0;
-            }
-            ccl_buf[ccl_bufidx++] = pattern[i++];
-          }
-          else if (ccl_bufidx >= MAX_CHAR_CLASS_LEN)
-          {
-              //fputs("exceeded internal buffer!\n", stderr);
-              return 0;
-          }
-          ccl_buf[ccl_bufidx++] = pattern[i];
-        }
-        if (ccl_bufidx >= MAX_CHAR_CLASS_LEN)
+  jit.code = 0;
+  jitpattern(&jit, pattern);
+  code = mmap(0, jit.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED)
+  {
+    return 0;
+  }
+  jit.code = (unsigned char*) code;
+  jitpattern(&jit, pattern);
+
+  /* Never writable and executable at once */
+  if (mprotect(code, jit.size, PROT_READ | PROT_EXEC) != 0)
+  {
+    munmap(code, jit.size);
+    return 0;
+  }
+  info(pattern)->jitcode = code;
+  info(pattern)->jitsize = jit.size;
+  return 1;
+#else
+  (void) pattern;
+  return 0;
+#endif
+}
+
+void re_jit_free(re_t pattern)
+{
+#ifdef RE_JIT_X86_64
+  if ((pattern != 0) && (info(pattern)->jitcode != 0))
+  {
+    munmap(info(pattern)->jitcode, info(pattern)->jitsize);
+    info(pattern)->jitcode = 0;
+    info(pattern)->jitsize = 0;
+  }
+#else
+  (void) pattern;
+#endif
+}
+
+re_dfa_t re_dfa_init(re_t pattern, void* buf, size_t bufsize)
+{
+  struct re_dfa* dfa = (struct re_dfa*) buf;
+  unsigned char rep[256]; /* a byte representing each class */
+  size_t space;
+  size_t maxsize;
+  int nobjects;
+  int b;
+  int i;
+
+  if ((pattern == 0) || (buf == 0) || (bufsize < sizeof(struct re_dfa)))
+  {
+    return 0;
+  }
+  nobjects = info(pattern)->nobjects;
+
+  /* Bytes that every object matches alike need only one transition per state */
+  dfa->nclasses = 0;
+  for (b = 0; b < 256; ++b)
+  {
+    int cls;
+    for (cls = 0; cls < dfa->nclasses; ++cls)
+    {
+      for (i = 0; i < nobjects - 1; ++i)
+      {
+        if (matchone(pattern[i], (char) b) != matchone(pattern[i], (char) rep[cls]))
         {
-            /* Catches cases such as [00000000000000000000000000000000000000][ */
-            //fputs("exceeded internal buffer!\n", stderr);
-            return 0;
+          break;
         }
-        /* Null-terminate string end */
-        ccl_buf[ccl_bufidx++] = 0;
-        re_compiled[j].u.ccl = &ccl_buf[buf_begin];
-      } break;
-
-      /* Other characters: */
-      default:
+      }
+      if (i == nobjects - 1)
       {
-        re_compiled[j].type = CHAR;
-        re_compiled[j].u.ch = c;
+        break;
+      }
+    }
+    if (cls == dfa->nclasses)
+    {
+      rep[dfa->nclasses++] = (unsigned char) b;
+    }
+    dfa->classmap[b] = (unsigned char) cls;
+  }
+
+  /* A state has at most 2 * nobjects items: the START item, and one per thread-state */
+  maxsize = sizeof(dfastate_t) + ((dfa->nclasses + 2 * nobjects) * sizeof(int));
+  space = (bufsize - sizeof(struct re_dfa) > INT_MAX) ? INT_MAX : (bufsize - sizeof(struct re_dfa));
+  dfa->pattern = pattern;
+  dfa->nobjects = nobjects;
+  dfa->nbuckets = (int) (space / (DFA_BUCKET_BYTES + sizeof(int)));
+  if ((dfa->nbuckets == 0) || (space - (dfa->nbuckets * sizeof(int)) < 2 * maxsize))
+  {
+    return 0;
+  }
+  dfa->buckets = (int*) (dfa + 1);
+  dfa->cache = (unsigned char*) (dfa->buckets + dfa->nbuckets);
+  dfa->cachesize = (int) (space - (dfa->nbuckets * sizeof(int)));
+  dfaflush(dfa);
+  return dfa;
+}
+
+int re_dfa_matchn(re_dfa_t dfa, const char* text, int textlength, int* matchlength)
+{
+  const char* start;
+  int idx;
+
+  *matchlength = 0;
+  if (dfa == 0)
+  {
+    return -1;
+  }
+  if (findliteral(info(dfa->pattern)->required, info(dfa->pattern)->requiredlength, text, text + textlength) == 0)
+  {
+    return -1;
+  }
+  start = findstart(info(dfa->pattern), text, text + textlength);
+  if (start == 0)
+  {
+    return -1;
+  }
+  idx = matchdfa(dfa, start, textlength - (int) (start - text), matchlength);
+  return (idx == -1) ? -1 : (int) (start - text) + idx;
+}
+
+size_t re_set_size(const char** patterns, int npatterns)
+{
+  int nstates;
+  int nnodes;
+  size_t size = setsize(patterns, npatterns, &nstates, &nnodes);
+
+  /* The cache must hold at least two states of the largest possible size */
+  if (size == 0)
+  {
+    return 0;
+  }
+  return size + 2 * (sizeof(setstate_t) + (256 + nstates + 2 * npatterns) * sizeof(int));
+}
+
+re_set_t re_set_compile(const char** patterns, int npatterns, void* buf, size_t bufsize)
+{
+  struct re_set* set = (struct re_set*) buf;
+  unsigned char* p = (unsigned char*) buf;
+  unsigned char newclass[256];
+  int remap[2 * 256];
+  int nstates;
+  int nnodes;
+  int i;
+  int j;
+  int b;
+
+  if ((buf == 0) || (npatterns < 0) || (re_set_size(patterns, npatterns) == 0) || (bufsize < re_set_size(patterns, npatterns)))
+  {
+    return 0;
+  }
+  setsize(patterns, npatterns, &nstates, &nnodes);
+
+  p += ALIGNED(sizeof(struct re_set));
+  set->patterns = (regex_t**) p;
+  p += ALIGNED(npatterns * sizeof(regex_t*));
+  set->base = (int*) p;
+  set->owner = set->base + npatterns + 1;
+  set->mark = set->owner + nstates;
+  set->items = set->mark + nstates;
+  set->unanchored = set->items + nstates;
+  set->empty = set->unanchored + nstates;
+  p += ALIGNED((2 * npatterns + 1 + 4 * nstates) * sizeof(int));
+  set->found = p;
+  memset(set->found, 0, (size_t) npatterns);
+  p += ALIGNED(npatterns);
+  set->literals = (setliteral_t*) p;
+  p += ALIGNED(npatterns * sizeof(setliteral_t));
+  set->acfirst = (int*) p;
+  set->acfail = set->acfirst + nnodes + 1;
+  set->acout = set->acfail + nnodes;
+  set->acdict = set->acout + nnodes;
+  set->acreported = set->acdict + nnodes;
+  set->acnext = set->acreported + nnodes;
+  p += ALIGNED((5 * (size_t) nnodes + 1 + npatterns) * sizeof(int));
+  set->acbyte = p;
+  p += ALIGNED(nnodes);
+
+  set->npatterns = npatterns;
+  set->nstates = 0;
+  for (i = 0; i < npatterns; ++i)
+  {
+    size_t size = re_compiled_size(patterns[i]);
+    int n;
+
+    set->patterns[i] = re_compile_into(patterns[i], p, size);
+    p += ALIGNED(size);
+    set->base[i] = set->nstates;
+    n = 2 * info(set->patterns[i])->nobjects;
+    for (j = 0; j < n; ++j)
+    {
+      set->owner[set->nstates + j] = i;
+      set->mark[set->nstates + j] = 0;
+    }
+    set->nstates += n;
+  }
+  set->base[npatterns] = set->nstates;
+  set->stamp = 0;
+  set->generation = 0;
+  setbuildliterals(set);
+
+  /* Split the bytes into classes, one object at a time: bytes that every object matches alike stay together */
+  memset(set->classmap, 0, sizeof(set->classmap));
+  set->nclasses = 1;
+  for (i = 0; i < npatterns; ++i)
+  {
+    if (isliteral(set->patterns[i]))
+    {
+      continue;
+    }
+    for (j = 0; j < info(set->patterns[i])->nobjects - 1; ++j)
+    {
+      int n = 0;
+      for (b = 0; b < 2 * set->nclasses; ++b)
+      {
+        remap[b] = -1;
+      }
+      for (b = 0; b < 256; ++b)
+      {
+        int key = 2 * set->classmap[b] + matchone(set->patterns[i][j], (char) b);
+        if (remap[key] == -1)
+        {
+          remap[key] = n++;
+        }
+        newclass[b] = (unsigned char) remap[key];
+      }
+      memcpy(set->classmap, newclass, sizeof(newclass));
+      set->nclasses = n;
+    }
+  }
+  for (b = 255; b >= 0; --b)
+  {
+    set->classrep[set->classmap[b]] = (unsigned char) b;
+  }
+
+  /* Threads of unanchored patterns start at every position; some of them match there right away */
+  set->nunanchored = 0;
+  set->nempty = 0;
+  setnewlist(set);
+  for (i = 0; i < npatterns; ++i)
+  {
+    if ((set->patterns[i][0].type != BEGIN) && !isliteral(set->patterns[i]))
+    {
+      setaddstate(set, i, 0, &set->nunanchored);
+    }
+  }
+  memcpy(set->unanchored, set->items, set->nunanchored * sizeof(int));
+  for (i = 0; i < set->nunanchored; ++i)
+  {
+    if (setmatched(set, set->unanchored[i], 0) != -1)
+    {
+      set->empty[set->nempty++] = set->owner[set->unanchored[i]];
+    }
+  }
+
+  set->cache = p;
+  set->cachesize = (bufsize - (size_t) (p - (unsigned char*) buf) > INT_MAX) ? INT_MAX : (int) (bufsize - (size_t) (p - (unsigned char*) buf));
+  setflush(set);
+  return set;
+}
+
+int re_set_matchn(re_set_t set, const char* text, int textlength, int* ids)
+{
+  if (set == 0)
+  {
+    return 0;
+  }
+  return matchset(set, text, textlength, ids);
+}
+
+int re_set_match(re_set_t set, const char* text, int* ids)
+{
+  return re_set_matchn(set, text, (int) strlen(text), ids);
+}
+
+int re_find_next(re_t pattern, const char* text, int textlength, int* cursor, int* matchstart, int* matchlength)
+{
+  matcher_t m;
+
+  matcherinit(&m, 0, 0);
+  return findnext(pattern, text, textlength, cursor, matchstart, matchlength, &m);
+}
+
+int re_find_next_stats(re_t pattern, const char* text, int textlength, int* cursor, int* matchstart, int* matchlength, re_match_stats_t* stats)
+{
+  matcher_t m;
+  int found;
+
+  matcherinit(&m, 0, 0);
+  found = findnext(pattern, text, textlength, cursor, matchstart, matchlength, &m);
+#if (RE_STATS > 0)
+  stats->starts += m.stats.starts;
+  stats->matchpatterns += m.stats.matchpatterns;
+  stats->matchones += m.stats.matchones;
+  stats->backtracks += m.stats.backtracks;
+  stats->scanned += m.stats.scanned;
+  if (m.stats.maxdepth > stats->maxdepth)
+  {
+    stats->maxdepth = m.stats.maxdepth;
+  }
+#else
+  (void) stats;
+#endif
+  return found;
+}
+
+int re_match_batch(re_t pattern, const char** texts, const int* lengths, int n, int* results, int nthreads)
+{
+#if (RE_THREADS > 0)
+  batchrange_t ranges[BATCH_MAX_THREADS];
+  batchworker_t workers[BATCH_MAX_THREADS];
+  pthread_t threads[BATCH_MAX_THREADS];
+  int started[BATCH_MAX_THREADS];
+  batch_t batch;
+  int i;
+
+  if (nthreads <= 0)
+  {
+    nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  /* No more threads than there are chunks to go round */
+  if (nthreads > (n + BATCH_CHUNK - 1) / BATCH_CHUNK)
+  {
+    nthreads = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+  }
+  if (nthreads > BATCH_MAX_THREADS)
+  {
+    nthreads = BATCH_MAX_THREADS;
+  }
+  /* Short batches are matched right here: starting a thread takes longer than they do */
+  if ((pattern == 0) || (nthreads <= 1) || ((nthreads = batchthreads(texts, lengths, n, nthreads)) <= 1))
+  {
+    return matchbatch(pattern, texts, lengths, 0, n, results);
+  }
+
+  batch.pattern = pattern;
+  batch.texts = texts;
+  batch.lengths = lengths;
+  batch.results = results;
+  batch.nworkers = nthreads;
+  batch.matched = 0;
+  batch.ranges = ranges;
+  for (i = 0; i < nthreads; ++i)
+  {
+    const unsigned long long first = (unsigned long long) ((long long) n * i / nthreads);
+    const unsigned long long end = (unsigned long long) ((long long) n * (i + 1) / nthreads);
+
+    ranges[i].range = (first << 32) | end;
+    workers[i].batch = &batch;
+    workers[i].self = i;
+  }
+
+  /* The calling thread is worker 0; if a thread can't be started, the others steal its range */
+  for (i = 1; i < nthreads; ++i)
+  {
+    started[i] = (pthread_create(&threads[i], 0, batchworker, &workers[i]) == 0);
+  }
+  batchworker(&workers[0]);
+  for (i = 1; i < nthreads; ++i)
+  {
+    if (started[i])
+    {
+      pthread_join(threads[i], 0);
+    }
+  }
+  return batch.matched;
+#else
+  (void) nthreads;
+  return matchbatch(pattern, texts, lengths, 0, n, results);
+#endif
+}
+
+size_t re_scan_parallel(re_t pattern, const char* buf, size_t len, int nthreads, re_scan_callback_t callback, void* context)
+{
+  scan_t scan;
+#if (RE_THREADS > 0)
+  pthread_t threads[BATCH_MAX_THREADS];
+  int started[BATCH_MAX_THREADS];
+  int i;
+#endif
+
+  if ((pattern == 0) || (buf == 0) || (callback == 0))
+  {
+    return 0;
+  }
+  scan.pattern = pattern;
+  scan.buf = buf;
+  scan.len = len;
+  scan.callback = callback;
+  scan.context = context;
+  scan.next = 0;
+  scan.turn = 0;
+  scan.matched = 0;
+  scan.pieces = 0;
+  scan.reporting = 0;
+
+#if (RE_THREADS > 0)
+  if (nthreads <= 0)
+  {
+    nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  if (nthreads > BATCH_MAX_THREADS)
+  {
+    nthreads = BATCH_MAX_THREADS;
+  }
+  if (nthreads < 1)
+  {
+    nthreads = 1;
+  }
+#else
+  nthreads = 1;
+#endif
+  /* A few pieces per thread, so that threads that get done early have more to take */
+  scan.piecesize = len / (16 * (size_t) nthreads);
+  if (scan.piecesize < SCAN_PIECE)
+  {
+    scan.piecesize = SCAN_PIECE;
+  }
+  scan.npieces = (len + scan.piecesize - 1) / scan.piecesize;
+
+#if (RE_THREADS > 0)
+  if ((size_t) nthreads > scan.npieces)
+  {
+    nthreads = (int) scan.npieces;
+  }
+  /* Pieces that are matched ahead of their turn hold their matches here; without the memory, one thread does all */
+  if (nthreads > 1)
+  {
+    scan.pieces = (scanpiece_t*) calloc(scan.npieces, sizeof(scanpiece_t));
+    if (scan.pieces == 0)
+    {
+      nthreads = 1;
+    }
+  }
+  pthread_mutex_init(&scan.lock, 0);
+  pthread_cond_init(&scan.turned, 0);
+  for (i = 1; i < nthreads; ++i)
+  {
+    started[i] = (pthread_create(&threads[i], 0, scanworker, &scan) == 0);
+  }
+  scanpieces(&scan);
+  for (i = 1; i < nthreads; ++i)
+  {
+    if (started[i])
+    {
+      pthread_join(threads[i], 0);
+    }
+  }
+  pthread_cond_destroy(&scan.turned);
+  pthread_mutex_destroy(&scan.lock);
+  free(scan.pieces);
+#else
+  scanpieces(&scan);
+#endif
+  return scan.matched;
+}
+
+size_t re_stream_size(re_t pattern, size_t lookbehind)
+{
+  size_t nstates;
+
+  if (pattern == 0)
+  {
+    return 0;
+  }
+  nstates = 2 * (size_t) info(pattern)->nobjects;
+  return ALIGNED(sizeof(struct re_stream)) + ALIGNED(3 * nstates * sizeof(int)) + ALIGNED(2 * nstates * sizeof(size_t))
+       + ((lookbehind > 0) ? lookbehind : 1);
+}
+
+re_stream_t re_stream_init(re_t pattern, void* buf, size_t bufsize, re_stream_callback_t callback, void* context)
+{
+  struct re_stream* stream = (struct re_stream*) buf;
+  unsigned char* p = (unsigned char*) buf;
+  int nstates;
+  int i;
+
+  if ((pattern == 0) || (buf == 0) || (callback == 0) || (bufsize < re_stream_size(pattern, 1)))
+  {
+    return 0;
+  }
+  nstates = 2 * info(pattern)->nobjects;
+
+  stream->pattern = pattern;
+  stream->callback = callback;
+  stream->context = context;
+  stream->nobjects = info(pattern)->nobjects;
+  stream->nthreads = 0;
+  stream->current = 0;
+  stream->stamp = 1;
+  stream->searching = 1;
+  stream->pending = 0;
+  stream->failed = 0;
+  stream->pos = 0;
+  stream->total = 0;
+  stream->histstart = 0;
+  stream->histlength = 0;
+
+  p += ALIGNED(sizeof(struct re_stream));
+  stream->visited = (int*) p;
+  stream->state[0] = stream->visited + nstates;
+  stream->state[1] = stream->state[0] + nstates;
+  p += ALIGNED(3 * nstates * sizeof(int));
+  stream->start[0] = (size_t*) p;
+  stream->start[1] = stream->start[0] + nstates;
+  p += ALIGNED(2 * nstates * sizeof(size_t));
+  stream->history = (char*) p;
+  stream->histsize = bufsize - (size_t) (p - (unsigned char*) buf);
+  for (i = 0; i < nstates; ++i)
+  {
+    stream->visited[i] = 0;
+  }
+  return stream;
+}
+
+int re_stream_feed(re_stream_t stream, const char* text, int length)
+{
+  int i;
+
+  if ((stream == 0) || stream->failed)
+  {
+    return -1;
+  }
+  stream->nmatches = 0;
+  for (i = 0; i < length; ++i)
+  {
+    if (stream->histlength == stream->histsize)
+    {
+      /* Full: drop the text before the end of a pending match, or all of it if there is none */
+      const size_t keep = stream->pending ? stream->matchend : stream->total;
+
+      if (keep == stream->histstart)
+      {
+        stream->failed = 1;
+        return -1;
+      }
+      memmove(stream->history, stream->history + (keep - stream->histstart), stream->total - keep);
+      stream->histlength = stream->total - keep;
+      stream->histstart = keep;
+    }
+    stream->history[stream->histlength++] = text[i];
+    stream->total += 1;
+    streamrun(stream);
+  }
+  return stream->nmatches;
+}
+
+int re_stream_finish(re_stream_t stream)
+{
+  if ((stream == 0) || stream->failed)
+  {
+    return -1;
+  }
+  stream->nmatches = 0;
+  for (;;)
+  {
+    /* Whatever has matched at the end is final; the search after it starts on the text kept since */
+    streamstep(stream, -1);
+    if (!stream->pending)
+    {
+      break;
+    }
+    streamreport(stream);
+    streamrun(stream);
+  }
+  stream->searching = 0;
+  return stream->nmatches;
+}
+
+void re_cache_stats(re_cache_stats_t* stats)
+{
+#if (RE_CACHE_SIZE > 0)
+  stats->hits = __atomic_load_n(&cache.stats.hits, __ATOMIC_RELAXED);
+  stats->misses = __atomic_load_n(&cache.stats.misses, __ATOMIC_RELAXED);
+  stats->evictions = __atomic_load_n(&cache.stats.evictions, __ATOMIC_RELAXED);
+#else
+  stats->hits = 0;
+  stats->misses = 0;
+  stats->evictions = 0;
+#endif
+}
+
+void re_print(regex_t* pattern)
+{
+  const char* types[] = { "UNUSED", "DOT", "BEGIN", "END", "QUESTIONMARK", "STAR", "PLUS", "CHAR", "CHAR_CLASS", "INV_CHAR_CLASS", "DIGIT", "NOT_DIGIT", "ALPHA", "NOT_ALPHA", "WHITESPACE", "NOT_WHITESPACE", "BRANCH" };
+
+  int i;
+  int j;
+  int k;
+  for (i = 0; pattern[i].type != UNUSED; ++i)
+  {
+    printf("type: %s", types[pattern[i].type]);
+    if (pattern[i].type == CHAR_CLASS || pattern[i].type == INV_CHAR_CLASS)
+    {
+      /* Print the chars listed in the class, with runs collapsed to ranges */
+      int inverted = (pattern[i].type == INV_CHAR_CLASS);
+      printf(inverted ? " [^" : " [");
+      for (j = 1; j < 256; j = k)
+      {
+        for (k = j; (k < 256) && (matchbitmap(pattern[i].u.ccl, (char) k) != inverted); ++k)
+        {
+        }
+        if (k == j)
+        {
+          k += 1;
+        }
+        else if (k - j > 2)
+        {
+          printf("%c-%c", j, k - 1);
+        }
+        else
+        {
+          for (; j < k; ++j)
+          {
+            printf("%c", j);
+          }
+        }
+      }
+      printf("]");
+    }
+    else if (pattern[i].type == CHAR)
+    {
+      printf(" '%c'", pattern[i].u.ch);
+    }
+    printf("\n");
+  }
+}
+
+
+
+/* Private functions: */
+static int compile(const char* pattern, regex_t* re_compiled, int max_objects, unsigned char* ccl_buf, int* nobjects, int* nclasses)
+{
+  /* When re_compiled is NULL, nothing is written; objects and class-bitmaps are only counted. */
+  regex_t obj;
+  int ccl_idx = 0;
+
+  char c;     /* current char in pattern   */
+  int i = 0;  /* index into pattern        */
+  int j = 0;  /* index into re_compiled    */
+
+  while (pattern[i] != '\0' && (j+1 < max_objects))
+  {
+    c = pattern[i];
+    obj.type = UNUSED;  /* a lone '\\' at the end of the pattern leaves this in place */
+    obj.u.ccl = 0;
+
+    switch (c)
+    {
+      /* Meta-characters: */
+      case '^': {    obj.type = BEGIN;           } break;
+      case '$': {    obj.type = END;             } break;
+      case '.': {    obj.type = DOT;             } break;
+      case '*': {    obj.type = STAR;            } break;
+      case '+': {    obj.type = PLUS;            } break;
+      case '?': {    obj.type = QUESTIONMARK;    } break;
+/*    case '|': {    obj.type = BRANCH;          } break; <-- not working properly */
+
+      /* Escaped character-classes (\s \w ...): */
+      case '\\':
+      {
+        if (pattern[i+1] != '\0')
+        {
+          /* Skip the escape-char '\\' */
+          i += 1;
+          /* ... and check the next */
+          switch (pattern[i])
+          {
+            /* Meta-character: */
+            case 'd': {    obj.type = DIGIT;            obj.u.ccl = digit_bitmap;           } break;
+            case 'D': {    obj.type = NOT_DIGIT;        obj.u.ccl = not_digit_bitmap;       } break;
+            case 'w': {    obj.type = ALPHA;            obj.u.ccl = alpha_bitmap;           } break;
+            case 'W': {    obj.type = NOT_ALPHA;        obj.u.ccl = not_alpha_bitmap;       } break;
+            case 's': {    obj.type = WHITESPACE;       obj.u.ccl = whitespace_bitmap;      } break;
+            case 'S': {    obj.type = NOT_WHITESPACE;   obj.u.ccl = not_whitespace_bitmap;  } break;
+
+            /* Escaped character, e.g. '.' or '$' */
+            default:
+            {
+              obj.type = CHAR;
+              obj.u.ch = pattern[i];
+            } break;
+          }
+        }
+        /* '\\' as last char in pattern -> invalid regular expression. */
+/*
+        else
+        {
+          obj.type = CHAR;
+          obj.u.ch = pattern[i];
+        }
+*/
       } break;
+
+      /* Character class: */
+      case '[':
+      {
+        /* Remember where the class begins in the pattern. */
+        const char* ccl_begin;
+
+        /* Look-ahead to determine if negated */
+        if (pattern[i+1] == '^')
+        {
+          obj.type = INV_CHAR_CLASS;
+          i += 1; /* Increment i to avoid including '^' in the class */
+          if (pattern[i+1] == 0) /* incomplete pattern, missing non-zero char after '^' */
+          {
+            return 0;
+          }
+        }
+        else
+        {
+          obj.type = CHAR_CLASS;
+        }
+        ccl_begin = &pattern[i+1];
+
+        /* Find the closing ']', skipping escaped characters */
+        while (    (pattern[++i] != ']')
+                && (pattern[i]   != '\0')) /* Missing ] */
+        {
+          if (pattern[i] == '\\')
+          {
+            if (pattern[i+1] == 0) /* incomplete pattern, missing non-zero char after '\\' */
+            {
+              return 0;
+            }
+            i += 1;
+          }
+        }
+
+        /* Lower the class to a bitmap, so matching a char is a single bit-test */
+        if ((ccl_buf != 0) && (pattern[i] != '\0'))
+        {
+          unsigned char* bitmap = &ccl_buf[ccl_idx * CCL_BITMAP_SIZE];
+          int k;
+
+          for (k = 0; k < CCL_BITMAP_SIZE; ++k)
+          {
+            bitmap[k] = 0;
+          }
+          for (k = 1; k < 256; ++k)
+          {
+            if (matchcharclass((char) k, ccl_begin, &pattern[i]) != (obj.type == INV_CHAR_CLASS))
+            {
+              setbitmap(bitmap, (char) k);
+            }
+          }
+          if (obj.type == INV_CHAR_CLASS)
+          {
+            bitmap[0] |= 1; /* '\0' is only reachable through re_matchn() and is never part of a class */
+          }
+          obj.u.ccl = bitmap;
+        }
+        ccl_idx += 1;
+      } break;
+
+      /* Other characters: */
+      default:
+      {
+        obj.type = CHAR;
+        obj.u.ch = c;
+      } break;
+    }
+    /* no buffer-out-of-bounds access on invalid patterns - see https://github.com/kokke/tiny-regex-c/commit/1a279e04014b70b0695fba559a7c05d55e6ee90b */
+    if (pattern[i] == 0)
+    {
+      return 0;
+    }
+
+    if (re_compiled != 0)
+    {
+      re_compiled[j] = obj;
+    }
+    i += 1;
+    j += 1;
+  }
+  /* More symbols than fit: fail, rather than match a pattern cut short */
+  if (pattern[i] != '\0')
+  {
+    return 0;
+  }
+  /* 'UNUSED' is a sentinel used to indicate end-of-pattern */
+  if (re_compiled != 0)
+  {
+    re_compiled[j].type = UNUSED;
+    re_compiled[j].u.ccl = 0;
+
+    info(re_compiled)->engine = RE_DEFAULT_ENGINE;
+    info(re_compiled)->nobjects = j + 1;
+    info(re_compiled)->prefixlength = literalprefix(re_compiled, info(re_compiled)->prefix);
+    info(re_compiled)->requiredlength = requiredliteral(re_compiled, info(re_compiled)->required);
+    if (info(re_compiled)->requiredlength <= info(re_compiled)->prefixlength)
+    {
+      info(re_compiled)->requiredlength = 0; /* searching for the prefix already takes care of it */
+    }
+    info(re_compiled)->firstknown = firstbytes(re_compiled, info(re_compiled)->first);
+    info(re_compiled)->endanchored = (j > 0) && (re_compiled[j-1].type == END) && (re_compiled[0].type != BEGIN);
+    info(re_compiled)->jitcode = 0;
+    info(re_compiled)->jitsize = 0;
+  }
+
+  if (nobjects != 0)
+  {
+    *nobjects = j + 1;
+  }
+  if (nclasses != 0)
+  {
+    *nclasses = ccl_idx;
+  }
+  return 1;
+}
+
+static re_info_t* info(re_t pattern)
+{
+  return (re_info_t*) (pattern - INFO_OBJECTS);
+}
+
+static int literalprefix(const regex_t* pattern, char* prefix)
+{
+  /* Leading chars that are not optional; a char repeated by '+' is the last one that is certain. */
+  int i;
+
+  for (i = 0; (i < MAX_LITERAL_LENGTH) && (pattern[i].type == CHAR); ++i)
+  {
+    if ((pattern[i+1].type == STAR) || (pattern[i+1].type == QUESTIONMARK))
+    {
+      break;
+    }
+    prefix[i] = (char) pattern[i].u.ch;
+    if (pattern[i+1].type == PLUS)
+    {
+      return i + 1;
+    }
+  }
+  return i;
+}
+
+static int requiredliteral(const regex_t* pattern, char* required)
+{
+  /* Longest run of chars that every match contains: consecutive CHARs that are not optional.
+     A char repeated by '+' ends a run, and its last repetition starts the next one. */
+  char run[MAX_LITERAL_LENGTH];
+  int runlength = 0;
+  int best = 0;
+  int quantified;
+  int i;
+
+  for (i = 0; pattern[i].type != UNUSED; i += (quantified ? 2 : 1))
+  {
+    const int next = pattern[i+1].type;
+
+    quantified = ((next == STAR) || (next == PLUS) || (next == QUESTIONMARK));
+    if ((pattern[i].type == CHAR) && (next != STAR) && (next != QUESTIONMARK))
+    {
+      if (runlength < MAX_LITERAL_LENGTH)
+      {
+        run[runlength++] = (char) pattern[i].u.ch;
+      }
+      if (runlength > best)
+      {
+        best = runlength;
+        memcpy(required, run, (size_t) runlength);
+      }
+      if (next == PLUS)
+      {
+        run[0] = (char) pattern[i].u.ch;
+        runlength = 1;
+      }
+    }
+    else
+    {
+      runlength = 0;
+    }
+  }
+  return best;
+}
+
+static int firstbytes(const regex_t* pattern, unsigned char* bitmap)
+{
+  /* Collects the bytes a match can start with: those of the first object, and of the ones after it
+     while they may be skipped with '?' or '*'. Returns 0 if a match can start with any byte, or with none
+     at all because the pattern is anchored or can match the empty string. */
+  int i;
+  int b;
+
+  memset(bitmap, 0, CCL_BITMAP_SIZE);
+  if (pattern[0].type == BEGIN)
+  {
+    return 0;
+  }
+  for (i = 0; pattern[i].type != UNUSED; i += 2)
+  {
+    if ((pattern[i].type == END) && (pattern[i+1].type == UNUSED))
+    {
+      break; /* matches only at the end of text, which is never reported as a match */
+    }
+    for (b = 0; b < 256; ++b)
+    {
+      if (matchone(pattern[i], (char) b))
+      {
+        setbitmap(bitmap, (char) b);
+      }
+    }
+    if ((pattern[i+1].type != STAR) && (pattern[i+1].type != QUESTIONMARK))
+    {
+      break;
+    }
+  }
+  if (pattern[i].type == UNUSED)
+  {
+    return 0;
+  }
+  for (b = 0; (b < CCL_BITMAP_SIZE) && (bitmap[b] == 0xff); ++b)
+  {
+  }
+  return (b < CCL_BITMAP_SIZE);
+}
+
+static const char* findliteral(const char* literal, int length, const char* text, const char* end)
+{
+  /* Returns the first place in text that starts with literal, or NULL. */
+  if (length == 0)
+  {
+    return text;
+  }
+  while ((end - text) >= length)
+  {
+    text = (const char*) memchr(text, literal[0], (size_t) (end - text - length + 1));
+    if (text == 0)
+    {
+      return 0;
+    }
+    if (memcmp(text + 1, literal + 1, (size_t) (length - 1)) == 0)
+    {
+      return text;
+    }
+    text += 1;
+  }
+  return 0;
+}
+
+static const char* findstart(const re_info_t* pinfo, const char* text, const char* end)
+{
+  /* Returns the first place in text where a match can start, or NULL. */
+  if (pinfo->prefixlength > 0)
+  {
+    return findliteral(pinfo->prefix, pinfo->prefixlength, text, end);
+  }
+  if (pinfo->firstknown)
+  {
+    while ((text != end) && !matchbitmap(pinfo->first, *text))
+    {
+      text += 1;
+    }
+    return (text != end) ? text : 0;
+  }
+  return text;
+}
+
+#if (RE_CACHE_SIZE > 0)
+static int matchcached(const char* pattern, const char* text, int textlength, int* matchlength)
+{
+  unsigned int hash = 2166136261u;
+  cache_entry_t* entry;
+  int length;
+  int result;
+  int i;
+
+  for (length = 0; (pattern[length] != '\0') && (length < CACHE_PATTERN_LENGTH); ++length)
+  {
+    hash = (hash ^ (unsigned char) pattern[length]) * 16777619u;
+  }
+  if (length == CACHE_PATTERN_LENGTH)
+  {
+    /* Too long to keep: compile into a private buffer, which keeps this thread-safe */
+    regex_t objects[INFO_OBJECTS + MAX_REGEXP_OBJECTS];
+    unsigned char ccl_buf[MAX_REGEXP_OBJECTS * CCL_BITMAP_SIZE];
+
+    __atomic_add_fetch(&cache.stats.misses, 1, __ATOMIC_RELAXED);
+    if (!compile(pattern, &objects[INFO_OBJECTS], MAX_REGEXP_OBJECTS, ccl_buf, 0, 0))
+    {
+      *matchlength = 0;
+      return -1;
+    }
+    return re_matchpn(&objects[INFO_OBJECTS], text, textlength, matchlength);
+  }
+
+  pthread_rwlock_rdlock(&cache_lock);
+  entry = cachelookup(pattern, hash);
+  if (entry != 0)
+  {
+    __atomic_store_n(&entry->used, __atomic_add_fetch(&cache.tick, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cache.stats.hits, 1, __ATOMIC_RELAXED);
+    *matchlength = 0;
+    result = entry->valid ? re_matchpn(&entry->objects[INFO_OBJECTS], text, textlength, matchlength) : -1;
+    pthread_rwlock_unlock(&cache_lock);
+    return result;
+  }
+  pthread_rwlock_unlock(&cache_lock);
+
+  pthread_rwlock_wrlock(&cache_lock);
+  entry = cachelookup(pattern, hash); /* another thread may have compiled it meanwhile */
+  if (entry == 0)
+  {
+    int slot;
+    int* link;
+
+    if (cache.nentries < RE_CACHE_SIZE)
+    {
+      slot = cache.nentries++;
+    }
+    else
+    {
+      /* Drop the least recently used pattern */
+      slot = 0;
+      for (i = 1; i < RE_CACHE_SIZE; ++i)
+      {
+        if (cache.entries[i].used < cache.entries[slot].used)
+        {
+          slot = i;
+        }
+      }
+      for (link = &cache.buckets[cache.entries[slot].hash % CACHE_BUCKETS]; *link != slot + 1; link = &cache.entries[*link - 1].next)
+      {
+      }
+      *link = cache.entries[slot].next;
+      __atomic_add_fetch(&cache.stats.evictions, 1, __ATOMIC_RELAXED);
+    }
+
+    entry = &cache.entries[slot];
+    memcpy(entry->pattern, pattern, (size_t) length + 1);
+    entry->hash = hash;
+    entry->valid = compile(pattern, &entry->objects[INFO_OBJECTS], MAX_REGEXP_OBJECTS, entry->ccl_buf, 0, 0);
+    entry->next = cache.buckets[hash % CACHE_BUCKETS];
+    cache.buckets[hash % CACHE_BUCKETS] = slot + 1;
+    __atomic_add_fetch(&cache.stats.misses, 1, __ATOMIC_RELAXED);
+  }
+  else
+  {
+    __atomic_add_fetch(&cache.stats.hits, 1, __ATOMIC_RELAXED);
+  }
+  entry->used = ++cache.tick;
+  *matchlength = 0;
+  result = entry->valid ? re_matchpn(&entry->objects[INFO_OBJECTS], text, textlength, matchlength) : -1;
+  pthread_rwlock_unlock(&cache_lock);
+  return result;
+}
+
+static cache_entry_t* cachelookup(const char* pattern, unsigned int hash)
+{
+  int i;
+
+  for (i = cache.buckets[hash % CACHE_BUCKETS]; i != 0; i = cache.entries[i - 1].next)
+  {
+    if ((cache.entries[i - 1].hash == hash) && (strcmp(cache.entries[i - 1].pattern, pattern) == 0))
+    {
+      return &cache.entries[i - 1];
+    }
+  }
+  return 0;
+}
+#endif
+
+static int matchbitmap(const unsigned char* bitmap, char c)
+{
+  const unsigned char u = (unsigned char) c;
+  return (bitmap[(u & 15) | ((u >> 3) & 16)] >> ((u >> 4) & 7)) & 1;
+}
+static void setbitmap(unsigned char* bitmap, char c)
+{
+  const unsigned char u = (unsigned char) c;
+  bitmap[(u & 15) | ((u >> 3) & 16)] |= (unsigned char) (1 << ((u >> 4) & 7));
+}
+static int matchdigit(char c)
+{
+  return matchbitmap(digit_bitmap, c);
+}
+static int matchalphanum(char c)
+{
+  return matchbitmap(alpha_bitmap, c);
+}
+static int matchwhitespace(char c)
+{
+  return matchbitmap(whitespace_bitmap, c);
+}
+static int matchrange(char c, const char* str, const char* end)
+{
+  return (    (c != '-')
+           && (str < end)
+           && (str[0] != '-')
+           && (str + 1 < end)
+           && (str[1] == '-')
+           && (str + 2 < end)
+           && (    (c >= str[0])
+                && (c <= str[2])));
+}
+static int matchdot(char c)
+{
+#if defined(RE_DOT_MATCHES_NEWLINE) && (RE_DOT_MATCHES_NEWLINE == 1)
+  (void)c;
+  return 1;
+#else
+  return c != '\n' && c != '\r';
+#endif
+}
+static int ismetachar(char c)
+{
+  return ((c == 's') || (c == 'S') || (c == 'w') || (c == 'W') || (c == 'd') || (c == 'D'));
+}
+
+static int matchmetachar(char c, const char* str)
+{
+  switch (str[0])
+  {
+    case 'd': return  matchdigit(c);
+    case 'D': return !matchdigit(c);
+    case 'w': return  matchalphanum(c);
+    case 'W': return !matchalphanum(c);
+    case 's': return  matchwhitespace(c);
+    case 'S': return !matchwhitespace(c);
+    default:  return (c == str[0]);
+  }
+}
+
+static int matchcharclass(char c, const char* str, const char* end)
+{
+  /* Only used by compile() to build the class-bitmaps: [str, end) is the class as written in the pattern */
+  const char* begin = str;
+
+  for (; str < end; ++str)
+  {
+    if (matchrange(c, str, end))
+    {
+      return 1;
+    }
+    else if (str[0] == '\\')
+    {
+      /* Escape-char: increment str-ptr and match on next char */
+      str += 1;
+      if (matchmetachar(c, str))
+      {
+        return 1;
+      }
+      else if ((c == str[0]) && !ismetachar(c))
+      {
+        return 1;
+      }
+    }
+    else if (c == str[0])
+    {
+      if (c == '-')
+      {
+        return ((str == begin) || (str + 1 == end));
+      }
+      else
+      {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int matchone(regex_t p, char c)
+{
+  switch (p.type)
+  {
+    case DOT:            return matchdot(c);
+    case CHAR_CLASS:
+    case INV_CHAR_CLASS:
+    case DIGIT:
+    case NOT_DIGIT:
+    case ALPHA:
+    case NOT_ALPHA:
+    case WHITESPACE:
+    case NOT_WHITESPACE: return matchbitmap(p.u.ccl, c);
+    default:             return (p.u.ch == c);
+  }
+}
+
+static int matchrun(regex_t p, const char* text, const char* end)
+{
+  /* Number of chars at the start of text that match p: the greedy part of '*' and '+' */
+  const char* start = text;
+#ifdef RE_SIMD_X86
+  if ((end - text) >= 16)
+  {
+    text = matchrunsimd(p, text, end);
+  }
+#endif
+  while ((text != end) && matchone(p, *text))
+  {
+    text++;
+  }
+  return (int) (text - start);
+}
+
+#ifdef RE_SIMD_X86
+static const char* matchrunsimd(regex_t p, const char* text, const char* end)
+{
+  /* Skips whole blocks of chars that match p, using the widest instructions the CPU has.
+     Returns where the scalar loop takes over: at the first mismatch or in the last partial block. */
+  unsigned char buf[CCL_BITMAP_SIZE];
+  const unsigned char* bitmap = buf;
+  int b;
+
+  switch (p.type)
+  {
+    case CHAR_CLASS:
+    case INV_CHAR_CLASS:
+    case DIGIT:
+    case NOT_DIGIT:
+    case ALPHA:
+    case NOT_ALPHA:
+    case WHITESPACE:
+    case NOT_WHITESPACE:
+    {
+      bitmap = p.u.ccl;
+    } break;
+    case DOT:
+    {
+      if (matchdot('\n') && matchdot('\r'))
+      {
+        return end;
+      }
+      memset(buf, 0, sizeof(buf));
+      for (b = 0; b < 256; ++b)
+      {
+        if (matchdot((char) b))
+        {
+          setbitmap(buf, (char) b);
+        }
+      }
+    } break;
+    default:
+    {
+      memset(buf, 0, sizeof(buf));
+      setbitmap(buf, (char) p.u.ch);
+    } break;
+  }
+
+  if (__builtin_cpu_supports("avx2"))
+  {
+    return matchrunavx2(bitmap, text, end);
+  }
+  if (__builtin_cpu_supports("ssse3"))
+  {
+    return matchrunssse3(bitmap, text, end);
+  }
+  return text;
+}
+
+/* Class-membership of 16 (32) chars x at once: the low nibble of x picks a byte from each half of the
+   bitmap (pshufb zeroes the lanes whose index has bit 7 set, selecting the half), the high nibble picks the bit. */
+__attribute__((target("ssse3")))
+static const char* matchrunssse3(const unsigned char* bitmap, const char* text, const char* end)
+{
+  const __m128i lower = _mm_loadu_si128((const __m128i*) bitmap);
+  const __m128i upper = _mm_loadu_si128((const __m128i*) (bitmap + 16));
+  const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i top = _mm_set1_epi8(-128);
+
+  while ((end - text) >= 16)
+  {
+    const __m128i x = _mm_loadu_si128((const __m128i*) text);
+    const __m128i row = _mm_or_si128(_mm_shuffle_epi8(lower, x), _mm_shuffle_epi8(upper, _mm_xor_si128(x, top)));
+    const __m128i bit = _mm_shuffle_epi8(bits, _mm_and_si128(_mm_srli_epi16(x, 4), nibble));
+    const int misses = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), _mm_setzero_si128()));
+    if (misses != 0)
+    {
+      return text + __builtin_ctz((unsigned int) misses);
+    }
+    text += 16;
+  }
+  return text;
+}
+
+__attribute__((target("avx2")))
+static const char* matchrunavx2(const unsigned char* bitmap, const char* text, const char* end)
+{
+  const __m256i lower = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) bitmap));
+  const __m256i upper = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (bitmap + 16)));
+  const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                        1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i top = _mm256_set1_epi8(-128);
+
+  while ((end - text) >= 32)
+  {
+    const __m256i x = _mm256_loadu_si256((const __m256i*) text);
+    const __m256i row = _mm256_or_si256(_mm256_shuffle_epi8(lower, x), _mm256_shuffle_epi8(upper, _mm256_xor_si256(x, top)));
+    const __m256i bit = _mm256_shuffle_epi8(bits, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+    const unsigned int misses = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256()));
+    if (misses != 0)
+    {
+      return text + __builtin_ctz(misses);
+    }
+    text += 32;
+  }
+  return matchrunssse3(bitmap, text, end);
+}
+#endif
+
+static void matcherinit(matcher_t* m, unsigned long maxsteps, const volatile int* cancel)
+{
+  m->limited = (maxsteps > 0);
+  m->countdown = (m->limited && (maxsteps < MATCH_ROUND_STEPS)) ? maxsteps : MATCH_ROUND_STEPS;
+  m->left = m->limited ? (maxsteps - m->countdown) : 0;
+  m->cancel = cancel;
+  m->stopped = 0;
+  m->memo = 0;
+#if (RE_STATS > 0)
+  m->depth = 0;
+  memset(&m->stats, 0, sizeof(m->stats));
+#endif
+}
+
+/* Count n steps of work; returns 0 if the search has to stop instead. */
+static int matchsteps(matcher_t* m, unsigned long n)
+{
+  if (m->countdown > n)
+  {
+    m->countdown -= n;
+    return 1;
+  }
+  return matchround(m, n);
+}
+
+/* The round is over: start the next one, if the budget and the cancel-flag allow. */
+static int matchround(matcher_t* m, unsigned long n)
+{
+  const unsigned long over = n - m->countdown;
+
+  m->countdown = 0;
+  if (m->stopped)
+  {
+    return 0;
+  }
+#if defined(__GNUC__)
+  if ((m->cancel != 0) && __atomic_load_n(m->cancel, __ATOMIC_RELAXED))
+#else
+  if ((m->cancel != 0) && *m->cancel)
+#endif
+  {
+    m->stopped = 1;
+    return 0;
+  }
+  if (!m->limited)
+  {
+    m->countdown = MATCH_ROUND_STEPS;
+    return 1;
+  }
+  if (m->left <= over)
+  {
+    m->stopped = 1;
+    return 0;
+  }
+  m->left -= over;
+  m->countdown = (m->left < MATCH_ROUND_STEPS) ? m->left : MATCH_ROUND_STEPS;
+  m->left -= m->countdown;
+  return 1;
+}
+
+/* Has matchpattern() failed from pattern at text before? Offsets beyond the memo never have. */
+static int memoized(const matcher_t* m, const regex_t* pattern, const char* text)
+{
+  const size_t offset = (size_t) (text - m->memotext);
+  size_t bit;
+
+  if (offset >= m->memolength)
+  {
+    return 0;
+  }
+  bit = offset * m->memostride + (size_t) (pattern - m->memobase);
+  return (m->memo[bit / 8] >> (bit % 8)) & 1;
+}
+
+static void memoize(matcher_t* m, const regex_t* pattern, const char* text)
+{
+  const size_t offset = (size_t) (text - m->memotext);
+  size_t bit;
+
+  if (offset < m->memolength)
+  {
+    bit = offset * m->memostride + (size_t) (pattern - m->memobase);
+    m->memo[bit / 8] |= (unsigned char) (1 << (bit % 8));
+  }
+}
+
+/* re_matchpn() as far as m lets it go: returns -1 if it had to stop short, with m->stopped set. */
+static int matchtext(regex_t* pattern, const char* text, int textlength, int* matchlength, matcher_t* m)
+{
+  const char* end = text + textlength;
+  const re_info_t* pinfo;
+  const char* required;
+
+  *matchlength = 0;
+  if (pattern == 0)
+  {
+    return -1;
+  }
+  pinfo = info(pattern);
+
+  /* Text without the literal that every match contains needs no further look */
+  required = findliteral(pinfo->required, pinfo->requiredlength, text, end);
+  STAT_SCAN(m, text, required, pinfo->requiredlength, end);
+  if (required == 0)
+  {
+    return -1;
+  }
+
+  if (pinfo->endanchored)
+  {
+    /* Every match ends at the end of text, so look for the leftmost start backwards from there */
+    const int start = matchbackward(pattern, text, textlength, textlength, m);
+
+    if ((start == -1) || (start == textlength))
+    {
+      return -1;
+    }
+    *matchlength = textlength - start;
+    return start;
+  }
+  else if (pinfo->engine == RE_ENGINE_PIKEVM)
+  {
+    /* No match can start before the first place the pattern can start at */
+    const char* start = findstart(pinfo, text, end);
+    int idx;
+
+    STAT_SCAN(m, text, start, STARTLENGTH(pinfo), end);
+    if (start == 0)
+    {
+      return -1;
+    }
+    idx = matchpikevm(pattern, start, end, matchlength, m);
+    return (idx == -1) ? -1 : (int) (start - text) + idx;
+  }
+  else
+  {
+    if (pattern[0].type == BEGIN)
+    {
+      STAT_ADD(m, starts, 1);
+      return ((matchfirst(pinfo, &pattern[1], text, end, matchlength, m)) ? 0 : -1);
+    }
+    else
+    {
+      const char* start = text;
+
+      do
+      {
+        const char* from = text;
+
+        /* Skip straight to the next place the literal prefix occurs, or a byte that can start a match */
+        text = findstart(pinfo, from, end);
+        STAT_SCAN(m, from, text, STARTLENGTH(pinfo), end);
+        if (text == 0)
+        {
+          return -1;
+        }
+
+        /* ... and give up once the required literal doesn't occur anymore */
+        if ((pinfo->requiredlength > 0) && (text > required))
+        {
+          required = findliteral(pinfo->required, pinfo->requiredlength, text, end);
+          STAT_SCAN(m, text, required, pinfo->requiredlength, end);
+          if (required == 0)
+          {
+            return -1;
+          }
+        }
+
+        STAT_ADD(m, starts, 1);
+        if (matchfirst(pinfo, pattern, text, end, matchlength, m))
+        {
+          if (text == end)
+            return -1;
+
+          return (int) (text - start);
+        }
+      }
+      while ((text++ != end) && !m->stopped);
+    }
+  }
+  return -1;
+}
+
+/* re_find_next() with m: the prefilters and matchers look no further back than where they start, so searching the
+   rest of the text is the same as searching all of it from the cursor on. Neither prefilter finds anything past
+   the end of the match it leads to, so the next call, which starts there, has nothing to take over from this one. */
+static int findnext(regex_t* pattern, const char* text, int textlength, int* cursor, int* matchstart, int* matchlength, matcher_t* m)
+{
+  int start;
+
+  *matchlength = 0;
+  if ((pattern == 0) || (*cursor < 0) || (*cursor > textlength) || ((*cursor > 0) && (pattern[0].type == BEGIN)))
+  {
+    *cursor = textlength + 1;
+    return 0;
+  }
+  start = matchtext(pattern, text + *cursor, textlength - *cursor, matchlength, m);
+  if (start == -1)
+  {
+    *cursor = textlength + 1;
+    return 0;
+  }
+  *matchstart = *cursor + start;
+  *cursor = *matchstart + *matchlength + (*matchlength == 0);
+  return 1;
+}
+
+/* matchpattern() at the start of the pattern (after '^'): by the code of re_jit() if there is any, unless the
+   search has a budget, memo or counters that only the interpreter keeps */
+static int matchfirst(const re_info_t* pinfo, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m)
+{
+#if defined(RE_JIT_X86_64) && (RE_STATS == 0)
+  if ((pinfo->jitcode != 0) && !m->limited && (m->cancel == 0) && (m->memo == 0))
+  {
+    return ((jitmatch_t) pinfo->jitcode)(text, end, matchlength);
+  }
+#else
+  (void) pinfo;
+#endif
+  return matchpattern(pattern, text, end, matchlength, m);
+}
+
+
+#ifdef RE_JIT_X86_64
+/* x86-64 opcodes of the jumps, each followed by a rel32 */
+#define JIT_JMP   "\xE9"
+#define JIT_CALL  "\xE8"
+#define JIT_JE    "\x0F\x84"
+#define JIT_JNE   "\x0F\x85"
+#define JIT_JC    "\x0F\x82"
+#define JIT_JA    "\x0F\x87"
+#define JIT_JL    "\x0F\x8C"
+
+static void jitpattern(jit_t* jit, regex_t* pattern)
+{
+  int i = (pattern[0].type == BEGIN) ? 1 : 0;
+
+  jit->size = 0;
+  jit->ncalls = 0;
+  while (i != -1)
+  {
+    /* The previous function calls this one */
+    while (jit->ncalls > 0)
+    {
+      jitland(jit, jit->calls[--jit->ncalls]);
+    }
+    i = jitentry(jit, pattern, i);
+  }
+}
+
+/* Emit the function for matchpattern() on &pattern[i]; returns the object the next one starts at, or -1 */
+static int jitentry(jit_t* jit, regex_t* pattern, int i)
+{
+  size_t success;
+  size_t epilogue;
+  size_t fail;
+  size_t body;
+  size_t done;
+  size_t back;
+  size_t loop = 0;
+  size_t longrun;
+  int j = i;
+  int k;
+
+  /* The objects matchpattern() matches a char at a time, up to the one that ends its loop */
+  while (    (pattern[j].type != UNUSED)
+          && (pattern[j+1].type != QUESTIONMARK) && (pattern[j+1].type != STAR) && (pattern[j+1].type != PLUS)
+          && ((pattern[j].type != END) || (pattern[j+1].type != UNUSED)))
+  {
+    j += 1;
+  }
+
+  /* text in rbx, end in r12, matchlength in r13, *matchlength on entry in r14d; r15 counts a run.
+     Five pushes keep the stack 16-byte aligned for the calls. Returning 1 and 0 come first, so every
+     jump to them goes back to a known place. */
+  jitemit(jit, "\x53\x41\x54\x41\x55\x41\x56\x41\x57", 9);            /* push rbx, r12, r13, r14, r15 */
+  jitemit(jit, "\x48\x89\xFB\x49\x89\xF4\x49\x89\xD5\x44\x8B\x32", 12); /* mov rbx, rdi; mov r12, rsi; mov r13, rdx; mov r14d, [rdx] */
+  body = jitforward(jit, JIT_JMP);
+  success = jit->size;
+  jitemit(jit, "\xB8\x01\x00\x00\x00", 5);                             /* mov eax, 1 */
+  epilogue = jit->size;
+  jitemit(jit, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5B\xC3", 10);       /* pop r15, r14, r13, r12, rbx; ret */
+  fail = jit->size;
+  jitemit(jit, "\x45\x89\x75\x00\x31\xC0", 6);                         /* mov [r13], r14d; xor eax, eax */
+  jitjump(jit, JIT_JMP, epilogue);
+  jitland(jit, body);
+
+  if (j > i)
+  {
+    jitemit(jit, "\x4C\x89\xE0\x48\x29\xD8\x48\x3D", 8);               /* mov rax, r12; sub rax, rbx; cmp rax, j - i */
+    jitimm(jit, (unsigned long long) (j - i), 4);
+    jitjump(jit, JIT_JL, fail);
+    for (k = i; k < j; ++k)
+    {
+      jitemit(jit, "\x0F\xB6\x83", 3);                                 /* movzx eax, byte [rbx + k - i] */
+      jitimm(jit, (unsigned long long) (k - i), 4);
+      jittest(jit, pattern[k], fail);
+    }
+    jitemit(jit, "\x48\x81\xC3", 3);                                   /* add rbx, j - i */
+    jitimm(jit, (unsigned long long) (j - i), 4);
+    jitemit(jit, "\x41\x81\x45\x00", 4);                               /* add dword [r13], j - i */
+    jitimm(jit, (unsigned long long) (j - i), 4);
+  }
+
+  if (pattern[j].type == UNUSED)
+  {
+    jitjump(jit, JIT_JMP, success);
+    return -1;
+  }
+  else if (pattern[j+1].type == QUESTIONMARK)
+  {
+    /* matchquestion(): the rest of the pattern here, or after a char */
+    jitemit(jit, "\x48\x89\xDF\x4C\x89\xE6\x4C\x89\xEA", 9);           /* mov rdi, rbx; mov rsi, r12; mov rdx, r13 */
+    jit->calls[jit->ncalls++] = jitforward(jit, JIT_CALL);
+    jitemit(jit, "\x85\xC0", 2);                                       /* test eax, eax */
+    jitjump(jit, JIT_JNE, success);
+    jitemit(jit, "\x4C\x39\xE3", 3);                                   /* cmp rbx, r12 */
+    jitjump(jit, JIT_JE, fail);
+    jitemit(jit, "\x0F\xB6\x03", 3);                                   /* movzx eax, byte [rbx] */
+    jittest(jit, pattern[j], fail);
+    jitemit(jit, "\x48\x8D\x7B\x01\x4C\x89\xE6\x4C\x89\xEA", 10);      /* lea rdi, [rbx + 1]; mov rsi, r12; mov rdx, r13 */
+    jit->calls[jit->ncalls++] = jitforward(jit, JIT_CALL);
+    jitemit(jit, "\x85\xC0", 2);
+    jitjump(jit, JIT_JE, fail);
+    jitemit(jit, "\x41\xFF\x45\x00", 4);                               /* inc dword [r13] */
+    jitjump(jit, JIT_JMP, success);
+    return j + 2;
+  }
+  else if ((pattern[j+1].type == STAR) || (pattern[j+1].type == PLUS))
+  {
+    /* matchstar() and matchplus(): the run is counted in r15 by the loop at the end, which jumps back to done.
+       Runs of over 16 chars are left to matchrun(), for its SIMD; '.' that matches anything runs to the end. */
+    const int any = jitmatchesall(pattern[j]);
+
+    if (any)
+    {
+      jitemit(jit, "\x4D\x89\xE7\x49\x29\xDF", 6);                     /* mov r15, r12; sub r15, rbx */
+    }
+    else
+    {
+      jitemit(jit, "\x45\x31\xFF", 3);                                 /* xor r15d, r15d */
+      loop = jitforward(jit, JIT_JMP);
+    }
+    done = jit->size;
+    jitemit(jit, "\x45\x01\x7D\x00", 4);                               /* add [r13], r15d */
+    back = jit->size;
+    jitemit(jit, "\x49\x83\xFF", 3);                                   /* cmp r15, 0 for '*', 1 for '+' */
+    jitimm(jit, (pattern[j+1].type == PLUS) ? 1 : 0, 1);
+    jitjump(jit, JIT_JL, fail);
+    jitemit(jit, "\x4A\x8D\x3C\x3B\x4C\x89\xE6\x4C\x89\xEA", 10);      /* lea rdi, [rbx + r15]; mov rsi, r12; mov rdx, r13 */
+    jit->calls[jit->ncalls++] = jitforward(jit, JIT_CALL);
+    jitemit(jit, "\x85\xC0", 2);
+    jitjump(jit, JIT_JNE, success);
+    jitemit(jit, "\x41\xFF\x4D\x00\x49\xFF\xCF", 7);                   /* dec dword [r13]; dec r15 */
+    jitjump(jit, JIT_JMP, back);
+    if (!any)
+    {
+      jitland(jit, loop);
+      loop = jit->size;
+      jitemit(jit, "\x4A\x8D\x04\x3B\x4C\x39\xE0", 7);                 /* lea rax, [rbx + r15]; cmp rax, r12 */
+      jitjump(jit, JIT_JE, done);
+      jitemit(jit, "\x49\x83\xFF\x10", 4);                             /* cmp r15, 16 */
+      longrun = jitforward(jit, JIT_JE);
+      jitemit(jit, "\x42\x0F\xB6\x04\x3B", 5);                         /* movzx eax, byte [rbx + r15] */
+      jittest(jit, pattern[j], done);
+      jitemit(jit, "\x49\xFF\xC7", 3);                                 /* inc r15 */
+      jitjump(jit, JIT_JMP, loop);
+      jitland(jit, longrun);
+      jitemit(jit, "\x48\xBF", 2);                                      /* mov rdi, &pattern[j] */
+      jitimm(jit, (unsigned long long) (size_t) &pattern[j], 8);
+      jitemit(jit, "\x4A\x8D\x34\x3B\x4C\x89\xE2\x48\xB8", 9);         /* lea rsi, [rbx + r15]; mov rdx, r12; mov rax, jitrun */
+      jitimm(jit, (unsigned long long) (size_t) jitrun, 8);
+      jitemit(jit, "\xFF\xD0\x49\x01\xC7", 5);                         /* call rax; add r15, rax */
+      jitjump(jit, JIT_JMP, done);
+    }
+    return j + 2;
+  }
+  else
+  {
+    /* '$' at the end of the pattern */
+    jitemit(jit, "\x4C\x39\xE3", 3);                                   /* cmp rbx, r12 */
+    jitjump(jit, JIT_JNE, fail);
+    jitjump(jit, JIT_JMP, success);
+    return -1;
+  }
+}
+
+/* Called by the code of re_jit() for the rest of a long run */
+static long jitrun(const regex_t* p, const char* text, const char* end)
+{
+  return matchrun(*p, text, end);
+}
+
+static int jitmatchesall(regex_t p)
+{
+  int c;
+
+  for (c = 0; c < 256; ++c)
+  {
+    if (!matchone(p, (char) c))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Emit a test of the char in eax against p, as matchone() would do it, that jumps to miss if it doesn't match.
+   The chars p matches are found by asking matchone(); each 64 of them are a 64-bit immediate to bit-test. */
+static void jittest(jit_t* jit, regex_t p, size_t miss)
+{
+  unsigned long long bits[4] = { 0, 0, 0, 0 };
+  size_t hits[4];
+  size_t skip;
+  int nhits = 0;
+  int count = 0;
+  int last = 0;
+  int c;
+  int q;
+
+  for (c = 0; c < 256; ++c)
+  {
+    if (matchone(p, (char) c))
+    {
+      bits[c >> 6] |= 1ULL << (c & 63);
+      count += 1;
+      last = c;
+    }
+  }
+
+  if (count == 256)
+  {
+    return;
+  }
+  else if ((count == 1) || (count == 255))
+  {
+    /* A single char, or all but one */
+    if (count == 255)
+    {
+      for (last = 0; matchone(p, (char) last); ++last)
+      {
+      }
+    }
+    jitemit(jit, "\x3D", 1);                                           /* cmp eax, c */
+    jitimm(jit, (unsigned long long) last, 4);
+    jitjump(jit, (count == 1) ? JIT_JNE : JIT_JE, miss);
+    return;
+  }
+
+  for (q = 0; q < 4; ++q)
+  {
+    if (bits[q] != 0)
+    {
+      jitemit(jit, "\x89\xC1\x81\xE9", 4);                             /* mov ecx, eax; sub ecx, 64 * q */
+      jitimm(jit, (unsigned long long) (64 * q), 4);
+      jitemit(jit, "\x81\xF9\x3F\x00\x00\x00", 6);                     /* cmp ecx, 63 */
+      skip = jitforward(jit, JIT_JA);
+      jitemit(jit, "\x48\xBA", 2);                                     /* mov rdx, bits[q] */
+      jitimm(jit, bits[q], 8);
+      jitemit(jit, "\x48\x0F\xA3\xCA", 4);                             /* bt rdx, rcx */
+      hits[nhits++] = jitforward(jit, JIT_JC);
+      jitland(jit, skip);
+    }
+  }
+  jitjump(jit, JIT_JMP, miss);
+  while (nhits > 0)
+  {
+    jitland(jit, hits[--nhits]);
+  }
+}
+
+static void jitemit(jit_t* jit, const char* bytes, size_t n)
+{
+  if (jit->code != 0)
+  {
+    memcpy(&jit->code[jit->size], bytes, n);
+  }
+  jit->size += n;
+}
+
+/* value as an n-byte little-endian immediate */
+static void jitimm(jit_t* jit, unsigned long long value, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i)
+  {
+    if (jit->code != 0)
+    {
+      jit->code[jit->size] = (unsigned char) (value >> (8 * i));
+    }
+    jit->size += 1;
+  }
+}
+
+/* Jump to code already emitted */
+static void jitjump(jit_t* jit, const char* op, size_t target)
+{
+  const size_t n = strlen(op);
+
+  jitemit(jit, op, n);
+  jitimm(jit, (unsigned long long) (long long) (target - (jit->size + 4)), 4);
+}
+
+/* Jump ahead: returns where its rel32 goes, for jitland() to fill in */
+static size_t jitforward(jit_t* jit, const char* op)
+{
+  jitemit(jit, op, strlen(op));
+  jitimm(jit, 0, 4);
+  return jit->size - 4;
+}
+
+/* The jump of jitforward() lands here */
+static void jitland(jit_t* jit, size_t at)
+{
+  const size_t rel = jit->size - (at + 4);
+  size_t i;
+
+  if (jit->code != 0)
+  {
+    for (i = 0; i < 4; ++i)
+    {
+      jit->code[at + i] = (unsigned char) (rel >> (8 * i));
+    }
+  }
+}
+#endif
+
+
+static int matchstar(regex_t p, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m)
+{
+  int prelen = *matchlength;
+  const char* prepoint = text;
+  const int run = matchrun(p, text, end);
+  text += run;
+  *matchlength += run;
+  STAT_ADD(m, matchones, run + (text != end));
+  STAT_ENTER(m);
+  while ((text >= prepoint) && !m->stopped)
+  {
+    if (matchpattern(pattern, text--, end, matchlength, m))
+    {
+      STAT_LEAVE(m);
+      return 1;
+    }
+    (*matchlength)--;
+    STAT_ADD(m, backtracks, (text >= prepoint));
+  }
+
+  STAT_LEAVE(m);
+  *matchlength = prelen;
+  return 0;
+}
+
+static int matchplus(regex_t p, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m)
+{
+  const char* prepoint = text;
+  const int run = matchrun(p, text, end);
+  text += run;
+  *matchlength += run;
+  STAT_ADD(m, matchones, run + (text != end));
+  STAT_ENTER(m);
+  while ((text > prepoint) && !m->stopped)
+  {
+    if (matchpattern(pattern, text--, end, matchlength, m))
+    {
+      STAT_LEAVE(m);
+      return 1;
+    }
+    (*matchlength)--;
+    STAT_ADD(m, backtracks, (text > prepoint));
+  }
+
+  STAT_LEAVE(m);
+  return 0;
+}
+
+static int matchquestion(regex_t p, regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m)
+{
+  int matched = 0;
+
+  if (p.type == UNUSED)
+    return 1;
+  STAT_ENTER(m);
+  if (matchpattern(pattern, text, end, matchlength, m))
+  {
+    matched = 1;
+  }
+  else if (text != end)
+  {
+    STAT_ADD(m, matchones, 1);
+    if (matchone(p, *text++) && matchpattern(pattern, text, end, matchlength, m))
+    {
+      (*matchlength)++;
+      matched = 1;
+    }
+  }
+  STAT_LEAVE(m);
+  return matched;
+}
+
+
+#if 0
+
+/* Recursive matching */
+static int matchpattern(regex_t* pattern, const char* text, const char* end, int *matchlength, matcher_t* m)
+{
+  int pre = *matchlength;
+  int matched;
+  STAT_CALL(m);
+  if (((m->memo != 0) && memoized(m, pattern, text)) || !matchsteps(m, 1))
+  {
+    return 0;
+  }
+  if ((pattern[0].type == UNUSED) || (pattern[1].type == QUESTIONMARK))
+  {
+    matched = matchquestion(pattern[1], &pattern[2], text, end, matchlength, m);
+  }
+  else if (pattern[1].type == STAR)
+  {
+    matched = matchstar(pattern[0], &pattern[2], text, end, matchlength, m);
+  }
+  else if (pattern[1].type == PLUS)
+  {
+    matched = matchplus(pattern[0], &pattern[2], text, end, matchlength, m);
+  }
+  else if ((pattern[0].type == END) && pattern[1].type == UNUSED)
+  {
+    matched = (text == end);
+  }
+  else if ((text != end) && (STAT_ADD(m, matchones, 1), matchone(pattern[0], text[0])))
+  {
+    (*matchlength)++;
+    matched = matchpattern(&pattern[1], text+1, end, matchlength, m);
+  }
+  else
+  {
+    *matchlength = pre;
+    matched = 0;
+  }
+  if (!matched && (m->memo != 0))
+  {
+    memoize(m, pattern, text);
+  }
+  return matched;
+}
+
+#else
+
+/* Iterative matching */
+static int matchpattern(regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m)
+{
+  regex_t* const from = pattern;
+  const char* const at = text;
+  int pre = *matchlength;
+  STAT_CALL(m);
+  if ((m->memo != 0) && memoized(m, pattern, text))
+    return 0;
+  do
+  {
+    if (!matchsteps(m, 1))
+      break;
+
+    /* The quantifiers decide the rest of the pattern; on failure, fall through to restore matchlength */
+    if ((pattern[0].type == UNUSED) || (pattern[1].type == QUESTIONMARK))
+    {
+      if (matchquestion(pattern[0], &pattern[2], text, end, matchlength, m))
+        return 1;
+      break;
+    }
+    else if (pattern[1].type == STAR)
+    {
+      if (matchstar(pattern[0], &pattern[2], text, end, matchlength, m))
+        return 1;
+      break;
+    }
+    else if (pattern[1].type == PLUS)
+    {
+      if (matchplus(pattern[0], &pattern[2], text, end, matchlength, m))
+        return 1;
+      break;
+    }
+    else if ((pattern[0].type == END) && pattern[1].type == UNUSED)
+    {
+      if (text == end)
+        return 1;
+      break;
+    }
+/*  Branching is not working properly
+    else if (pattern[1].type == BRANCH)
+    {
+      return (matchpattern(pattern, text) || matchpattern(&pattern[2], text));
+    }
+*/
+  (*matchlength)++;
+  STAT_ADD(m, matchones, (text != end));
+  }
+  while ((text != end) && matchone(*pattern++, *text++));
+
+  if (m->memo != 0)
+    memoize(m, from, at);
+  *matchlength = pre;
+  return 0;
+}
+
+#endif
+
+
+/* Pike VM: runs all alternatives of the backtracking matcher in lock-step, one char at a time.
+   A thread-state is an index into the regex_t-array: the thread is about to consume a char for that
+   object, or has matched when it reached UNUSED (or the final END, at the end of the text).
+   The loop of a '+' needs a state of its own, which is numbered behind the array: nobjects + index.
+   Threads are kept in the order the backtracker would try them, so the first one to match wins. */
+typedef struct
+{
+  int  nthreads;
+  int*    state;  /* thread-states, highest priority first      */
+  size_t* start;  /* text-offset where each thread started      */
+} threadlist_t;
+
+typedef struct
+{
+  regex_t* pattern;
+  int      nobjects;
+  int*     visited;  /* visited[state] == stamp if state is already in the list being built */
+} pikevm_t;
+
+/* Where a thread goes from state: returns the state it moves to after consuming a char for object *obj,
+   or STATE_MATCH if it has matched, STATE_MATCH_AT_END if it matches only at the end of the text. */
+#define STATE_MATCH         (-1)
+#define STATE_MATCH_AT_END  (-2)
+
+static int nextstate(regex_t* pattern, int nobjects, int state, int* obj)
+{
+  *obj = state;
+  if (state >= nobjects)
+  {
+    *obj = state - nobjects - 1;
+    return state;
+  }
+  else if (pattern[state].type == UNUSED)
+  {
+    return STATE_MATCH;
+  }
+  else if (pattern[state+1].type == QUESTIONMARK)
+  {
+    return state + 2;
+  }
+  else if (pattern[state+1].type == STAR)
+  {
+    return state;
+  }
+  else if (pattern[state+1].type == PLUS)
+  {
+    return nobjects + state + 1;
+  }
+  else if ((pattern[state].type == END) && (pattern[state+1].type == UNUSED))
+  {
+    return STATE_MATCH_AT_END;
+  }
+  return state + 1;
+}
+
+static void addthread(pikevm_t* vm, threadlist_t* list, int state, size_t start, int stamp)
+{
+  regex_t* pattern = vm->pattern;
+
+  if (vm->visited[state] == stamp)
+  {
+    return;
+  }
+  vm->visited[state] = stamp;
+
+  if (state >= vm->nobjects)
+  {
+    /* '+' after the first char: greedy, so consuming another char comes first */
+    list->state[list->nthreads] = state;
+    list->start[list->nthreads++] = start;
+    addthread(vm, list, state - vm->nobjects + 1, start, stamp);
+  }
+  else if ((pattern[state].type != UNUSED) && (pattern[state+1].type == QUESTIONMARK))
+  {
+    /* '?' is non-greedy, so skipping the char comes first */
+    addthread(vm, list, state + 2, start, stamp);
+    list->state[list->nthreads] = state;
+    list->start[list->nthreads++] = start;
+  }
+  else
+  {
+    list->state[list->nthreads] = state;
+    list->start[list->nthreads++] = start;
+    if ((pattern[state].type != UNUSED) && (pattern[state+1].type == STAR))
+    {
+      addthread(vm, list, state + 2, start, stamp);
+    }
+  }
+}
+
+static int matchpikevm(regex_t* pattern, const char* text, const char* end, int* matchlength, matcher_t* m)
+{
+  const int nobjects = info(pattern)->nobjects;
+  const int textlength = (int) (end - text);
+  const int anchored = (pattern[0].type == BEGIN);
+  int visited[2 * nobjects];
+  int states[2][2 * nobjects];
+  size_t starts[2][2 * nobjects];
+  threadlist_t lists[2];
+  threadlist_t* clist = &lists[0];
+  threadlist_t* nlist = &lists[1];
+  threadlist_t* tmp;
+  pikevm_t vm;
+  int matchstart = -1;
+  int matchend = -1;
+  int pos;
+  int i;
+
+  vm.pattern = pattern;
+  vm.nobjects = nobjects;
+  vm.visited = visited;
+  for (i = 0; i < 2 * nobjects; ++i)
+  {
+    visited[i] = 0;
+  }
+  lists[0].state = states[0];
+  lists[0].start = starts[0];
+  lists[1].state = states[1];
+  lists[1].start = starts[1];
+  clist->nthreads = 0;
+
+  for (pos = 0; pos <= textlength; ++pos)
+  {
+    /* A new thread for a match starting here has the lowest priority. Like the backtracker,
+       unanchored patterns don't start a match at the end of the text, anchored ones only at 0. */
+    if ((matchstart == -1) && (anchored ? (pos == 0) : (pos < textlength)))
+    {
+      STAT_ADD(m, starts, 1);
+      addthread(&vm, clist, anchored ? 1 : 0, pos, pos + 1);
+    }
+    if ((clist->nthreads == 0) || !matchsteps(m, (unsigned long) clist->nthreads))
+    {
+      break;
+    }
+
+    nlist->nthreads = 0;
+    for (i = 0; i < clist->nthreads; ++i)
+    {
+      int obj;
+      int next = nextstate(pattern, nobjects, clist->state[i], &obj);
+
+      if ((next == STATE_MATCH) || ((next == STATE_MATCH_AT_END) && (pos == textlength)))
+      {
+        /* Match: threads after this one have lower priority and are cut off */
+        matchstart = (int) clist->start[i];
+        matchend = pos;
+        break;
+      }
+      STAT_ADD(m, matchones, (next >= 0) && (pos < textlength));
+      if ((next >= 0) && (pos < textlength) && matchone(pattern[obj], text[pos]))
+      {
+        addthread(&vm, nlist, next, clist->start[i], pos + 2);
+      }
+    }
+
+    tmp = clist;
+    clist = nlist;
+    nlist = tmp;
+  }
+
+  if (matchstart == -1)
+  {
+    return -1;
+  }
+  *matchlength = matchend - matchstart;
+  return matchstart;
+}
+
+
+/* Leftmost start of a match ending at matchend: scans backwards, tracking which thread-states
+   can still reach the end of the match. Stops as soon as none can, so it costs about as much as the match is long. */
+static int matchbackward(regex_t* pattern, const char* text, int textlength, int matchend, matcher_t* m)
+{
+  const int nobjects = info(pattern)->nobjects;
+  unsigned char reach[2][2 * nobjects];
+  unsigned char* cur = reach[0];
+  unsigned char* nxt = reach[1];
+  unsigned char* tmp;
+  int matchstart = -1;
+  int pos;
+  int i;
+
+  if (pattern[0].type == BEGIN)
+  {
+    return 0;
+  }
+
+  for (pos = matchend; (pos >= 0) && matchsteps(m, (unsigned long) nobjects); --pos)
+  {
+    int alive = 0;
+
+    /* A state reaches the end if its own thread does, or if it falls through to one that does.
+       Fall-throughs ('?', '*' and the loop of '+') always go to a higher object, so go top-down. */
+    for (i = 2 * nobjects - 1; i >= 0; --i)
+    {
+      int obj;
+      int next;
+      int ok = 0;
+
+      if ((i >= nobjects) && ((i == nobjects) || (pattern[i - nobjects].type != PLUS)))
+      {
+        cur[i] = 0;
+        continue;
+      }
+      next = nextstate(pattern, nobjects, i, &obj);
+      if (next == STATE_MATCH)
+      {
+        ok = (pos == matchend);
+      }
+      else if (next == STATE_MATCH_AT_END)
+      {
+        ok = (pos == matchend) && (matchend == textlength);
+      }
+      else
+      {
+        ok = (pos < matchend) && nxt[next] && matchone(pattern[obj], text[pos]);
+      }
+      cur[i] = ok;
+    }
+    for (i = nobjects - 1; i >= 0; --i)
+    {
+      if ((pattern[i].type != UNUSED) && ((pattern[i+1].type == QUESTIONMARK) || (pattern[i+1].type == STAR)))
+      {
+        cur[i] |= cur[i + 2];
+      }
+    }
+    for (i = nobjects + 1; i < 2 * nobjects; ++i)
+    {
+      if (pattern[i - nobjects].type == PLUS)
+      {
+        cur[i] |= cur[i - nobjects + 1];
+      }
+    }
+
+    for (i = 0; i < 2 * nobjects; ++i)
+    {
+      alive |= cur[i];
+    }
+    if (!alive)
+    {
+      break;
+    }
+    if (cur[0])
+    {
+      matchstart = pos;
+    }
+    tmp = cur;
+    cur = nxt;
+    nxt = tmp;
+  }
+  return matchstart;
+}
+
+
+static dfastate_t* dfastate(struct re_dfa* dfa, int offset)
+{
+  return (dfastate_t*) (dfa->cache + offset);
+}
+
+static void dfaflush(struct re_dfa* dfa)
+{
+  int i;
+  for (i = 0; i < dfa->nbuckets; ++i)
+  {
+    dfa->buckets[i] = DFA_NOSTATE;
+  }
+  dfa->cacheused = 0;
+  dfa->nstates = 0;
+  dfa->since_flush = 0;
+}
+
+/* Find the state with these items in the cache or add it; DFA_NOSTATE if the cache is full. */
+static int dfastate_lookup(struct re_dfa* dfa, const int* items, int nitems, int matched)
+{
+  unsigned int hash = 2166136261u;
+  dfastate_t* s;
+  int size;
+  int offset;
+  int i;
+
+  for (i = 0; i < nitems; ++i)
+  {
+    hash = (hash ^ (unsigned int) items[i]) * 16777619u;
+  }
+  for (offset = dfa->buckets[hash % dfa->nbuckets]; offset != DFA_NOSTATE; offset = s->chain)
+  {
+    s = dfastate(dfa, offset);
+    if ((s->hash == (int) hash) && (s->nitems == nitems) && (memcmp(&s->next[dfa->nclasses], items, nitems * sizeof(int)) == 0))
+    {
+      return offset;
+    }
+  }
+  size = (int) (sizeof(dfastate_t) + ((dfa->nclasses + nitems) * sizeof(int)));
+  if (dfa->cachesize - dfa->cacheused < size)
+  {
+    return DFA_NOSTATE;
+  }
+
+  offset = dfa->cacheused;
+  dfa->cacheused += size;
+  dfa->nstates += 1;
+  s = dfastate(dfa, offset);
+  s->nitems = nitems;
+  s->matched = matched;
+  s->hash = (int) hash;
+  s->chain = dfa->buckets[hash % dfa->nbuckets];
+  for (i = 0; i < dfa->nclasses; ++i)
+  {
+    s->next[i] = DFA_NOSTATE;
+  }
+  memcpy(&s->next[dfa->nclasses], items, nitems * sizeof(int));
+  dfa->buckets[hash % dfa->nbuckets] = offset;
+  return offset;
+}
+
+/* Items of the state after consuming c from items (or the start state, if items is NULL).
+   With inject set, the START item starts another thread; at the end of the text it doesn't.
+   stamp must differ from the one of every earlier step with the same vm. */
+static int dfastep(pikevm_t* vm, const int* items, int nitems, char c, int inject, int stamp, int* out, int* matched)
+{
+  regex_t* pattern = vm->pattern;
+  const int nobjects = vm->nobjects;
+  const int start_item = 2 * nobjects;
+  size_t starts[2 * nobjects + 1];
+  threadlist_t list;
+  int i;
+
+  list.nthreads = 0;
+  list.state = out;
+  list.start = starts;
+
+  if (items == 0)
+  {
+    addthread(vm, &list, (pattern[0].type == BEGIN) ? 1 : 0, 0, stamp);
+    if (pattern[0].type != BEGIN)
+    {
+      out[list.nthreads++] = start_item;
+    }
+  }
+  for (i = 0; i < nitems; ++i)
+  {
+    if (items[i] == start_item)
+    {
+      if (inject)
+      {
+        addthread(vm, &list, 0, 0, stamp);
+        out[list.nthreads++] = start_item;
+      }
+    }
+    else
+    {
+      int obj;
+      int next = nextstate(pattern, nobjects, items[i], &obj);
+      if ((next >= 0) && matchone(pattern[obj], c))
+      {
+        addthread(vm, &list, next, 0, stamp);
+      }
+    }
+  }
+
+  /* Threads behind a match are cut off */
+  *matched = 0;
+  for (i = 0; i < list.nthreads; ++i)
+  {
+    if ((out[i] < nobjects) && (pattern[out[i]].type == UNUSED))
+    {
+      *matched = 1;
+      return i + 1;
+    }
+  }
+  return list.nthreads;
+}
+
+/* Threads left at the end of the text match there if they reached UNUSED or a final END */
+static int dfamatchesatend(struct re_dfa* dfa, const int* items, int nitems)
+{
+  int i;
+  for (i = 0; i < nitems; ++i)
+  {
+    int obj;
+    if (    (items[i] < 2 * dfa->nobjects)
+         && (nextstate(dfa->pattern, dfa->nobjects, items[i], &obj) < 0))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int matchdfa(struct re_dfa* dfa, const char* text, int textlength, int* matchlength)
+{
+  const int maxitems = 2 * dfa->nobjects + 1;
+  int items[2][maxitems];
+  int keep[maxitems];
+  int visited[2 * dfa->nobjects];
+  int* out = items[0];
+  int* cur = 0;
+  matcher_t m;
+  pikevm_t vm;
+  int ncur = 0;
+  int nitems;
+  int matched;
+  int matchend = -1;
+  int flushpos = 0;  /* where this call last flushed the cache */
+  int s;
+  int pos;
+  int i;
+
+  if ((textlength == 0) && (dfa->pattern[0].type != BEGIN))
+  {
+    return -1;
+  }
+
+  vm.pattern = dfa->pattern;
+  vm.nobjects = dfa->nobjects;
+  vm.visited = visited;
+  for (i = 0; i < 2 * dfa->nobjects; ++i)
+  {
+    visited[i] = 0;
+  }
+
+  nitems = dfastep(&vm, 0, 0, 0, 0, 1, out, &matched);
+  s = dfastate_lookup(dfa, out, nitems, matched);
+  if (s == DFA_NOSTATE)
+  {
+    dfaflush(dfa);
+    s = dfastate_lookup(dfa, out, nitems, matched);
+  }
+
+  /* s is DFA_NOSTATE once the cache fills up so fast that flushing it doesn't pay off:
+     from there on the items at hand take the steps of the Pike VM, without caching them */
+  for (pos = 0; ; ++pos)
+  {
+    dfastate_t* state = 0;
+    int cls;
+    int next;
+
+    if (s != DFA_NOSTATE)
+    {
+      state = dfastate(dfa, s);
+      cur = &state->next[dfa->nclasses];
+      ncur = state->nitems;
+      matched = state->matched;
+    }
+
+    if (pos == textlength)
+    {
+      if (dfamatchesatend(dfa, cur, ncur))
+      {
+        matchend = pos;
+      }
+      break;
     }
-    /* no buffer-out-of-bounds access on invalid patterns - see https://github.com/kokke/tiny-regex-c/commit/1a279e04014b70b0695fba559a7c05d55e6ee90b */
-    if (pattern[i] == 0)
+    if (matched)
+    {
+      matchend = pos;
+    }
+    if (ncur == 0)
+    {
+      break;
+    }
+    if (pos == textlength - 1)
+    {
+      /* No new thread starts at the end of the text, so the last step is not cached */
+      nitems = dfastep(&vm, cur, ncur, text[pos], 0, pos + 2, out, &matched);
+      if (dfamatchesatend(dfa, out, nitems))
+      {
+        matchend = textlength;
+      }
+      break;
+    }
+
+    if (s == DFA_NOSTATE)
+    {
+      ncur = dfastep(&vm, cur, ncur, text[pos], 1, pos + 2, out, &matched);
+      cur = out;
+      out = (out == items[0]) ? items[1] : items[0];
+      continue;
+    }
+
+    cls = dfa->classmap[(unsigned char) text[pos]];
+    next = state->next[cls];
+    if (next == DFA_NOSTATE)
+    {
+      nitems = dfastep(&vm, cur, ncur, text[pos], 1, pos + 2, out, &matched);
+      next = dfastate_lookup(dfa, out, nitems, matched);
+      if (next == DFA_NOSTATE)
+      {
+        /* Cache full: flush it, unless it fills up so fast that uncached steps are the better deal */
+        dfa->since_flush += pos - flushpos;
+        flushpos = pos;
+        if (dfa->since_flush < DFA_MIN_BYTES * dfa->nstates)
+        {
+          cur = out;
+          ncur = nitems;
+          out = (out == items[0]) ? items[1] : items[0];
+          s = DFA_NOSTATE;
+          continue;
+        }
+        memcpy(keep, cur, ncur * sizeof(int));
+        dfaflush(dfa);
+        s = dfastate_lookup(dfa, keep, ncur, state->matched);
+        state = dfastate(dfa, s);
+        next = dfastate_lookup(dfa, out, nitems, matched);
+      }
+      state->next[cls] = next;
+    }
+    s = next;
+  }
+  dfa->since_flush += pos - flushpos;
+
+  if (matchend == -1)
+  {
+    return -1;
+  }
+  matcherinit(&m, 0, 0);
+  pos = matchbackward(dfa->pattern, text, textlength, matchend, &m);
+  *matchlength = matchend - pos;
+  return pos;
+}
+
+
+static size_t setsize(const char** patterns, int npatterns, int* nstates, int* nnodes)
+{
+  /* Bytes for the set without its cache, 0 if a pattern is invalid */
+  size_t size = ALIGNED(sizeof(struct re_set)) + ALIGNED(npatterns * sizeof(regex_t*)) + ALIGNED(npatterns) + ALIGNED(npatterns * sizeof(setliteral_t));
+  int i;
+
+  *nstates = 0;
+  *nnodes = 1;
+  for (i = 0; i < npatterns; ++i)
+  {
+    int nobjects;
+    int nclasses;
+
+    if ((patterns[i] == 0) || !compile(patterns[i], 0, RE_MAX_SYMBOLS + 1, 0, &nobjects, &nclasses))
     {
       return 0;
     }
+    size += ALIGNED(re_compiled_size(patterns[i]));
+    *nstates += 2 * nobjects;
+    if (nclasses == 0)
+    {
+      *nnodes += nobjects - 1; /* room for it in the trie, should it be a literal */
+    }
+  }
+  size += ALIGNED((5 * (size_t) *nnodes + 1 + npatterns) * sizeof(int)) + ALIGNED(*nnodes);
+  return size + ALIGNED((2 * npatterns + 1 + 4 * (size_t) *nstates) * sizeof(int));
+}
 
-    i += 1;
-    j += 1;
+static int isliteral(const regex_t* pattern)
+{
+  /* Nothing but chars, at least one */
+  int i;
+  for (i = 0; pattern[i].type == CHAR; ++i)
+  {
+  }
+  return (i > 0) && (pattern[i].type == UNUSED);
+}
+
+static int compareliterals(const void* a, const void* b)
+{
+  const regex_t* x = ((const setliteral_t*) a)->literal;
+  const regex_t* y = ((const setliteral_t*) b)->literal;
+  int i;
+
+  for (i = 0; (x[i].type == CHAR) && (y[i].type == CHAR) && (x[i].u.ch == y[i].u.ch); ++i)
+  {
+  }
+  if ((x[i].type == CHAR) && (y[i].type == CHAR))
+  {
+    return (x[i].u.ch > y[i].u.ch) ? 1 : -1;
+  }
+  return (x[i].type == CHAR) - (y[i].type == CHAR);
+}
+
+/* Child of node on byte c, or -1. The children of the root are looked up in a table, there are the most of them. */
+static int setchild(const struct re_set* set, int node, unsigned char c)
+{
+  int i;
+
+  if (node == 0)
+  {
+    return (set->acroot[c] == 0) ? -1 : set->acroot[c];
+  }
+  for (i = set->acfirst[node]; (i < set->acfirst[node + 1]) && (set->acbyte[i] <= c); ++i)
+  {
+    if (set->acbyte[i] == c)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* Node reached from node on byte c, following the acfail-links until one has a child on c. */
+static int setgoto(const struct re_set* set, int node, unsigned char c)
+{
+  int child;
+
+  while ((child = setchild(set, node, c)) == -1)
+  {
+    if (node == 0)
+    {
+      return 0;
+    }
+    node = set->acfail[node];
+  }
+  return child;
+}
+
+static void setbuildliterals(struct re_set* set)
+{
+  int depth;
+  int i;
+
+  set->nliterals = 0;
+  for (i = 0; i < set->npatterns; ++i)
+  {
+    set->acnext[i] = -1;
+    if (isliteral(set->patterns[i]))
+    {
+      set->literals[set->nliterals].literal = set->patterns[i];
+      set->literals[set->nliterals].id = i;
+      set->literals[set->nliterals].node = 0;
+      set->nliterals += 1;
+    }
+  }
+  qsort(set->literals, (size_t) set->nliterals, sizeof(setliteral_t), compareliterals);
+
+  /* Sorted, the literals add the nodes of each depth in breadth-first order: the children of a node
+     come from consecutive literals, and each new prefix is a new node */
+  set->nnodes = 1;
+  set->acfirst[0] = -1;
+  set->acout[0] = -1;
+  for (depth = 0; ; ++depth)
+  {
+    int parent = -1;
+    int byte = -1;
+    int added = 0;
+
+    for (i = 0; i < set->nliterals; ++i)
+    {
+      setliteral_t* l = &set->literals[i];
+
+      if (l->node == -1)
+      {
+        continue; /* added up to its end already */
+      }
+      if ((l->node != parent) || (l->literal[depth].u.ch != byte))
+      {
+        parent = l->node;
+        byte = l->literal[depth].u.ch;
+        if (set->acfirst[parent] == -1)
+        {
+          set->acfirst[parent] = set->nnodes;
+        }
+        set->acfirst[set->nnodes] = -1;
+        set->acout[set->nnodes] = -1;
+        set->acbyte[set->nnodes] = (unsigned char) byte;
+        set->nnodes += 1;
+      }
+      l->node = set->nnodes - 1;
+      if (l->literal[depth + 1].type != CHAR)
+      {
+        set->acnext[l->id] = set->acout[l->node];
+        set->acout[l->node] = l->id;
+        l->node = -1;
+      }
+      added = 1;
+    }
+    if (!added)
+    {
+      break;
+    }
+  }
+  /* Leaves have no children: their range ends where the next node's starts */
+  set->acfirst[set->nnodes] = set->nnodes;
+  for (i = set->nnodes - 1; i >= 0; --i)
+  {
+    if (set->acfirst[i] == -1)
+    {
+      set->acfirst[i] = set->acfirst[i + 1];
+    }
+  }
+
+  for (i = 0; i < 256; ++i)
+  {
+    set->acroot[i] = 0;
+  }
+  for (i = set->acfirst[0]; i < set->acfirst[1]; ++i)
+  {
+    set->acroot[set->acbyte[i]] = i;
+  }
+
+  /* Parents come before their children, so their links are known by the time the children need them */
+  set->acfail[0] = 0;
+  set->acdict[0] = -1;
+  set->acreported[0] = 0;
+  for (i = 0; i < set->nnodes; ++i)
+  {
+    int child;
+    for (child = set->acfirst[i]; child < set->acfirst[i + 1]; ++child)
+    {
+      const int fail = (i == 0) ? 0 : setgoto(set, set->acfail[i], set->acbyte[child]);
+
+      set->acfail[child] = fail;
+      set->acdict[child] = (set->acout[fail] != -1) ? fail : set->acdict[fail];
+      set->acreported[child] = 0;
+    }
+  }
+}
+
+/* Record the literal patterns that occur in text. */
+static void setscanliterals(struct re_set* set, const char* text, int textlength, int* ids, int* nfound)
+{
+  int found = 0;
+  int node = 0;
+  int pos;
+
+  for (pos = 0; (pos < textlength) && (found < set->nliterals); ++pos)
+  {
+    int n;
+
+    node = setgoto(set, node, (unsigned char) text[pos]);
+    /* The patterns that end here are those of node and its acdict-chain: once a node is recorded, so is its chain */
+    for (n = (set->acout[node] != -1) ? node : set->acdict[node]; (n != -1) && (set->acreported[n] != set->generation); n = set->acdict[n])
+    {
+      int p;
+
+      set->acreported[n] = set->generation;
+      for (p = set->acout[n]; p != -1; p = set->acnext[p])
+      {
+        setfound(set, p, ids, nfound);
+        found += 1;
+      }
+    }
+  }
+}
+
+static setstate_t* setdfastate(struct re_set* set, int offset)
+{
+  return (setstate_t*) (set->cache + offset);
+}
+
+static void setflush(struct re_set* set)
+{
+  int i;
+  for (i = 0; i < SET_BUCKETS; ++i)
+  {
+    set->buckets[i] = DFA_NOSTATE;
+  }
+  set->cacheused = 0;
+  set->start = DFA_NOSTATE;
+}
+
+static void setnewlist(struct re_set* set)
+{
+  if (set->stamp == INT_MAX)
+  {
+    memset(set->mark, 0, set->nstates * sizeof(int));
+    set->stamp = 0;
+  }
+  set->stamp += 1;
+}
+
+/* Add thread-state (local to pattern p) to the list being built, with the states it falls through to. */
+static void setaddstate(struct re_set* set, int p, int state, int* nitems)
+{
+  regex_t* pattern = set->patterns[p];
+  const int nobjects = info(pattern)->nobjects;
+
+  if (set->mark[set->base[p] + state] == set->stamp)
+  {
+    return;
+  }
+  set->mark[set->base[p] + state] = set->stamp;
+  set->items[(*nitems)++] = set->base[p] + state;
+
+  if (state >= nobjects)
+  {
+    setaddstate(set, p, state - nobjects + 1, nitems);
+  }
+  else if ((pattern[state].type != UNUSED) && ((pattern[state+1].type == QUESTIONMARK) || (pattern[state+1].type == STAR)))
+  {
+    setaddstate(set, p, state + 2, nitems);
+  }
+}
+
+static int compareints(const void* a, const void* b)
+{
+  return (*(const int*) a > *(const int*) b) - (*(const int*) a < *(const int*) b);
+}
+
+/* Build the items that follow items (plus the unanchored start-states) on c, or the start items if items is NULL. */
+static int setstep(struct re_set* set, const int* items, int nitems, char c)
+{
+  int n = 0;
+  int i;
+
+  setnewlist(set);
+  if (items == 0)
+  {
+    for (i = 0; i < set->npatterns; ++i)
+    {
+      if (set->patterns[i][0].type == BEGIN)
+      {
+        setaddstate(set, i, 1, &n);
+      }
+    }
+  }
+  else
+  {
+    for (i = 0; i < nitems + set->nunanchored; ++i)
+    {
+      const int item = (i < nitems) ? items[i] : set->unanchored[i - nitems];
+      const int p = set->owner[item];
+      regex_t* pattern = set->patterns[p];
+      int obj;
+      int next = nextstate(pattern, info(pattern)->nobjects, item - set->base[p], &obj);
+
+      if ((next >= 0) && matchone(pattern[obj], c))
+      {
+        setaddstate(set, p, next, &n);
+      }
+    }
+  }
+  qsort(set->items, (size_t) n, sizeof(int), compareints);
+  return n;
+}
+
+/* The pattern that item belongs to if it has matched (with atend set: or matches at the end of the text), else -1. */
+static int setmatched(struct re_set* set, int item, int atend)
+{
+  const int p = set->owner[item];
+  regex_t* pattern = set->patterns[p];
+  int obj;
+  int next = nextstate(pattern, info(pattern)->nobjects, item - set->base[p], &obj);
+
+  return ((next == STATE_MATCH) || (atend && (next == STATE_MATCH_AT_END))) ? p : -1;
+}
+
+static void setfound(struct re_set* set, int p, int* ids, int* nfound)
+{
+  if (!set->found[p])
+  {
+    set->found[p] = 1;
+    ids[(*nfound)++] = p;
+  }
+}
+
+/* Find the state with the items being built in the cache or add it; DFA_NOSTATE if the cache is full. */
+static int setlookup(struct re_set* set, int nitems)
+{
+  unsigned int hash = 2166136261u;
+  setstate_t* s;
+  int nmatched = 0;
+  int natend = 0;
+  int size;
+  int offset;
+  int i;
+
+  for (i = 0; i < nitems; ++i)
+  {
+    hash = (hash ^ (unsigned int) set->items[i]) * 16777619u;
+  }
+  for (offset = set->buckets[hash % SET_BUCKETS]; offset != DFA_NOSTATE; offset = s->chain)
+  {
+    s = setdfastate(set, offset);
+    if ((s->hash == (int) hash) && (s->nitems == nitems) && (memcmp(&s->next[set->nclasses], set->items, nitems * sizeof(int)) == 0))
+    {
+      return offset;
+    }
+  }
+  for (i = 0; i < nitems; ++i)
+  {
+    nmatched += (setmatched(set, set->items[i], 0) != -1);
+    natend += (setmatched(set, set->items[i], 1) != -1);
+  }
+  natend -= nmatched;
+  size = (int) (sizeof(setstate_t) + ((set->nclasses + nitems + nmatched + natend) * sizeof(int)));
+  if (set->cachesize - set->cacheused < size)
+  {
+    return DFA_NOSTATE;
+  }
+
+  offset = set->cacheused;
+  set->cacheused += size;
+  s = setdfastate(set, offset);
+  s->nitems = nitems;
+  s->nmatched = nmatched;
+  s->natend = natend;
+  s->hash = (int) hash;
+  s->chain = set->buckets[hash % SET_BUCKETS];
+  s->reported = -1;
+  for (i = 0; i < set->nclasses; ++i)
+  {
+    s->next[i] = DFA_NOSTATE;
+  }
+  memcpy(&s->next[set->nclasses], set->items, nitems * sizeof(int));
+  /* The patterns that have matched, followed by those that match only at the end of the text */
+  nmatched = 0;
+  for (i = 0; i < nitems; ++i)
+  {
+    if (setmatched(set, set->items[i], 0) != -1)
+    {
+      s->next[set->nclasses + nitems + nmatched++] = set->owner[set->items[i]];
+    }
+  }
+  for (i = 0; i < nitems; ++i)
+  {
+    if ((setmatched(set, set->items[i], 0) == -1) && (setmatched(set, set->items[i], 1) != -1))
+    {
+      s->next[set->nclasses + nitems + nmatched++] = set->owner[set->items[i]];
+    }
+  }
+  set->buckets[hash % SET_BUCKETS] = offset;
+  return offset;
+}
+
+static int matchset(struct re_set* set, const char* text, int textlength, int* ids)
+{
+  int nfound = 0;
+  int s;
+  int pos;
+  int i;
+
+  if (set->generation == INT_MAX)
+  {
+    setflush(set); /* no state is left that was reported with a generation about to be reused */
+    memset(set->acreported, 0, set->nnodes * sizeof(int));
+    set->generation = 0;
+  }
+  set->generation += 1;
+
+  if (set->nliterals > 0)
+  {
+    setscanliterals(set, text, textlength, ids, &nfound);
+  }
+
+  if (set->start == DFA_NOSTATE)
+  {
+    s = setlookup(set, setstep(set, 0, 0, 0));
+    if (s == DFA_NOSTATE)
+    {
+      setflush(set);
+      s = setlookup(set, setstep(set, 0, 0, 0));
+    }
+    set->start = s;
+  }
+  s = set->start;
+
+  /* Unanchored patterns that match the empty string match anywhere but at the end of the text */
+  if (textlength > 0)
+  {
+    for (i = 0; i < set->nempty; ++i)
+    {
+      setfound(set, set->empty[i], ids, &nfound);
+    }
+  }
+
+  for (pos = 0; ; ++pos)
+  {
+    setstate_t* state = setdfastate(set, s);
+    int cls;
+    int next;
+
+    if (pos == textlength)
+    {
+      for (i = 0; i < state->nmatched + state->natend; ++i)
+      {
+        setfound(set, state->next[set->nclasses + state->nitems + i], ids, &nfound);
+      }
+      break;
+    }
+    if ((state->nmatched > 0) && (state->reported != set->generation))
+    {
+      state->reported = set->generation;
+      for (i = 0; i < state->nmatched; ++i)
+      {
+        setfound(set, state->next[set->nclasses + state->nitems + i], ids, &nfound);
+      }
+    }
+    if ((nfound == set->npatterns) || ((state->nitems == 0) && (set->nunanchored == 0)))
+    {
+      break;
+    }
+
+    cls = set->classmap[(unsigned char) text[pos]];
+    next = state->next[cls];
+    if (next == DFA_NOSTATE)
+    {
+      const int nitems = setstep(set, &state->next[set->nclasses], state->nitems, (char) set->classrep[cls]);
+
+      next = setlookup(set, nitems);
+      if (next == DFA_NOSTATE)
+      {
+        /* Cache full: start over with just the new state (the old one is gone, so is the transition) */
+        setflush(set);
+        next = setlookup(set, nitems);
+      }
+      else
+      {
+        state->next[cls] = next;
+      }
+    }
+    s = next;
   }
-  /* 'UNUSED' is a sentinel used to indicate end-of-pattern */
-  re_compiled[j].type = UNUSED;
 
-  return (re_t) re_compiled;
+  /* Clear only the flags that were set, the cost of a call shouldn't grow with the number of patterns */
+  for (i = 0; i < nfound; ++i)
+  {
+    set->found[ids[i]] = 0;
+  }
+  qsort(ids, (size_t) nfound, sizeof(int), compareints);
+  return nfound;
 }
 
-void re_print(regex_t* pattern)
+/* Run the threads over byte c at stream->pos, or over the end of the text if c is -1. */
+static void streamstep(struct re_stream* stream, int c)
 {
-  const char* types[] = { "UNUSED", "DOT", "BEGIN", "END", "QUESTIONMARK", "STAR", "PLUS", "CHAR", "CHAR_CLASS", "INV_CHAR_CLASS", "DIGIT", "NOT_DIGIT", "ALPHA", "NOT_ALPHA", "WHITESPACE", "NOT_WHITESPACE", "BRANCH" };
-
+  regex_t* pattern = stream->pattern;
+  const int nobjects = stream->nobjects;
+  const int anchored = (pattern[0].type == BEGIN);
+  threadlist_t clist;
+  threadlist_t nlist;
+  pikevm_t vm;
   int i;
-  int j;
-  char c;
-  for (i = 0; i < MAX_REGEXP_OBJECTS; ++i)
+
+  vm.pattern = pattern;
+  vm.nobjects = nobjects;
+  vm.visited = stream->visited;
+  clist.nthreads = stream->nthreads;
+  clist.state = stream->state[stream->current];
+  clist.start = stream->start[stream->current];
+  nlist.nthreads = 0;
+  nlist.state = stream->state[!stream->current];
+  nlist.start = stream->start[!stream->current];
+
+  /* Same as matchpikevm(): a match doesn't start at the end of the text unless the pattern is anchored */
+  if (stream->searching && !stream->pending && (anchored ? (stream->pos == 0) : (c != -1)))
+  {
+    addthread(&vm, &clist, anchored ? 1 : 0, stream->pos, stream->stamp);
+  }
+  if (stream->stamp == INT_MAX - 1)
   {
-    if (pattern[i].type == UNUSED)
+    for (i = 0; i < 2 * nobjects; ++i)
     {
-      break;
+      stream->visited[i] = 0;
     }
+    stream->stamp = 0;
+  }
+  stream->stamp += 1;
 
-    printf("type: %s", types[pattern[i].type]);
-    if (pattern[i].type == CHAR_CLASS || pattern[i].type == INV_CHAR_CLASS)
+  for (i = 0; i < clist.nthreads; ++i)
+  {
+    int obj;
+    int next = nextstate(pattern, nobjects, clist.state[i], &obj);
+
+    if ((next == STATE_MATCH) || ((next == STATE_MATCH_AT_END) && (c == -1)))
     {
-      printf(" [");
-      for (j = 0; j < MAX_CHAR_CLASS_LEN; ++j)
-      {
-        c = pattern[i].u.ccl[j];
-        if ((c == '\0') || (c == ']'))
-        {
-          break;
-        }
-        printf("%c", c);
-      }
-      printf("]");
+      stream->pending = 1;
+      stream->matchstart = clist.start[i];
+      stream->matchend = stream->pos;
+      break;
     }
-    else if (pattern[i].type == CHAR)
+    if ((next >= 0) && (c != -1) && matchone(pattern[obj], (char) c))
     {
-      printf(" '%c'", pattern[i].u.ch);
+      addthread(&vm, &nlist, next, clist.start[i], stream->stamp);
     }
-    printf("\n");
   }
-}
 
-
-
-/* Private functions: */
-static int matchdigit(char c)
-{
-  return isdigit(c);
-}
-static int matchalpha(char c)
-{
-  return isalpha(c);
-}
-static int matchwhitespace(char c)
-{
-  return isspace(c);
+  stream->nthreads = nlist.nthreads;
+  stream->current = !stream->current;
+  if (c != -1)
+  {
+    stream->pos += 1;
+  }
 }
-static int matchalphanum(char c)
+
+/* Report the pending match and search on from its end; an anchored pattern is done. */
+static void streamreport(struct re_stream* stream)
 {
-  return ((c == '_') || matchalpha(c) || matchdigit(c));
+  stream->callback(stream->context, stream->matchstart, stream->matchend - stream->matchstart);
+  stream->nmatches += 1;
+  stream->pending = 0;
+  stream->nthreads = 0;
+  stream->searching = (stream->pattern[0].type != BEGIN);
+  stream->pos = stream->matchend + (stream->matchend == stream->matchstart);
 }
-static int matchrange(char c, const char* str)
+
+/* Run the threads over the text fed so far, reporting matches as they become final. */
+static void streamrun(struct re_stream* stream)
 {
-  return (    (c != '-')
-           && (str[0] != '\0')
-           && (str[0] != '-')
-           && (str[1] == '-')
-           && (str[2] != '\0')
-           && (    (c >= str[0])
-                && (c <= str[2])));
+  while (stream->pos < stream->total)
+  {
+    streamstep(stream, (unsigned char) stream->history[stream->pos - stream->histstart]);
+    if (stream->pending && (stream->nthreads == 0))
+    {
+      streamreport(stream);
+    }
+  }
 }
-static int matchdot(char c)
+
+/* Match texts first to end of a batch, returns how many matched. */
+static int matchbatch(regex_t* pattern, const char** texts, const int* lengths, int first, int end, int* results)
 {
-#if defined(RE_DOT_MATCHES_NEWLINE) && (RE_DOT_MATCHES_NEWLINE == 1)
-  (void)c;
-  return 1;
-#else
-  return c != '\n' && c != '\r';
-#endif
+  int matched = 0;
+  int i;
+
+  for (i = first; i < end; ++i)
+  {
+    const int length = (lengths != 0) ? lengths[i] : (int) strlen(texts[i]);
+
+    results[2 * i] = re_matchpn(pattern, texts[i], length, &results[2 * i + 1]);
+    matched += (results[2 * i] != -1);
+  }
+  return matched;
 }
-static int ismetachar(char c)
+
+#if (RE_THREADS > 0)
+/* Threads the batch has work for, up to nthreads: one per BATCH_THREAD_BYTES. Texts are measured until there is enough for all. */
+static int batchthreads(const char** texts, const int* lengths, int n, int nthreads)
 {
-  return ((c == 's') || (c == 'S') || (c == 'w') || (c == 'W') || (c == 'd') || (c == 'D'));
+  const unsigned long long wanted = (unsigned long long) nthreads * BATCH_THREAD_BYTES;
+  unsigned long long work = 0;
+  int i;
+
+  for (i = 0; (i < n) && (work < wanted); ++i)
+  {
+    work += BATCH_TEXT_BYTES + ((lengths != 0) ? (unsigned long long) lengths[i] : (unsigned long long) strlen(texts[i]));
+  }
+  return (work >= wanted) ? nthreads : (int) (work / BATCH_THREAD_BYTES);
 }
 
-static int matchmetachar(char c, const char* str)
+static void* batchworker(void* arg)
 {
-  switch (str[0])
+  batchworker_t* worker = (batchworker_t*) arg;
+  batch_t* batch = worker->batch;
+  int matched = 0;
+
+  do
   {
-    case 'd': return  matchdigit(c);
-    case 'D': return !matchdigit(c);
-    case 'w': return  matchalphanum(c);
-    case 'W': return !matchalphanum(c);
-    case 's': return  matchwhitespace(c);
-    case 'S': return !matchwhitespace(c);
-    default:  return (c == str[0]);
+    int first;
+    int end;
+
+    while (batchtake(&batch->ranges[worker->self], BATCH_CHUNK, &first, &end))
+    {
+      matched += matchbatch(batch->pattern, batch->texts, batch->lengths, first, end, batch->results);
+    }
   }
+  while (batchsteal(batch, worker->self));
+
+  __atomic_add_fetch(&batch->matched, matched, __ATOMIC_RELAXED);
+  return 0;
 }
 
-static int matchcharclass(char c, const char* str)
+/* Take up to count texts from the front of range; 0 if it is empty. */
+static int batchtake(batchrange_t* range, int count, int* first, int* end)
 {
-  do
+  unsigned long long r = __atomic_load_n(&range->range, __ATOMIC_ACQUIRE);
+
+  for (;;)
   {
-    if (matchrange(c, str))
+    const int lo = (int) (r >> 32);
+    const int hi = (int) (r & 0xffffffffu);
+    const int take = (hi - lo < count) ? (hi - lo) : count;
+
+    if (take <= 0)
     {
-      return 1;
+      return 0;
     }
-    else if (str[0] == '\\')
+    if (__atomic_compare_exchange_n(&range->range, &r, ((unsigned long long) (lo + take) << 32) | (unsigned long long) hi,
+                                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
     {
-      /* Escape-char: increment str-ptr and match on next char */
-      str += 1;
-      if (matchmetachar(c, str))
-      {
-        return 1;
-      }
-      else if ((c == str[0]) && !ismetachar(c))
-      {
-        return 1;
-      }
+      *first = lo;
+      *end = lo + take;
+      return 1;
     }
-    else if (c == str[0])
+  }
+}
+
+/* Move the back half of another thread's range into the (empty) range of self; 0 if there is no work left. */
+static int batchsteal(batch_t* batch, int self)
+{
+  int i;
+
+  for (i = 1; i < batch->nworkers; ++i)
+  {
+    batchrange_t* victim = &batch->ranges[(self + i) % batch->nworkers];
+    unsigned long long r = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+
+    for (;;)
     {
-      if (c == '-')
+      const int lo = (int) (r >> 32);
+      const int hi = (int) (r & 0xffffffffu);
+      const int take = (hi - lo + 1) / 2;
+
+      if (take <= 0)
       {
-        return ((str[-1] == '\0') || (str[1] == '\0'));
+        break;
       }
-      else
+      if (__atomic_compare_exchange_n(&victim->range, &r, ((unsigned long long) lo << 32) | (unsigned long long) (hi - take),
+                                      0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
       {
+        /* Nobody takes from an empty range, so storing the new one needs no compare-and-swap */
+        __atomic_store_n(&batch->ranges[self].range, ((unsigned long long) (hi - take) << 32) | (unsigned long long) hi, __ATOMIC_RELEASE);
         return 1;
       }
     }
   }
-  while (*str++ != '\0');
-
   return 0;
 }
+#endif
 
-static int matchone(regex_t p, char c)
+#if (RE_THREADS > 0)
+static void* scanworker(void* arg)
 {
-  switch (p.type)
-  {
-    case DOT:            return matchdot(c);
-    case CHAR_CLASS:     return  matchcharclass(c, (const char*)p.u.ccl);
-    case INV_CHAR_CLASS: return !matchcharclass(c, (const char*)p.u.ccl);
-    case DIGIT:          return  matchdigit(c);
-    case NOT_DIGIT:      return !matchdigit(c);
-    case ALPHA:          return  matchalphanum(c);
-    case NOT_ALPHA:      return !matchalphanum(c);
-    case WHITESPACE:     return  matchwhitespace(c);
-    case NOT_WHITESPACE: return !matchwhitespace(c);
-    default:             return  (p.u.ch == c);
-  }
+  scanpieces((scan_t*) arg);
+  return 0;
 }
+#endif
 
-static int matchstar(regex_t p, regex_t* pattern, const char* text, int* matchlength)
+/* Offset of the first line that starts at or after offset. */
+static size_t scanlinestart(const scan_t* scan, size_t offset)
 {
-  int prelen = *matchlength;
-  const char* prepoint = text;
-  while ((text[0] != '\0') && matchone(p, *text))
-  {
-    text++;
-    (*matchlength)++;
-  }
-  while (text >= prepoint)
+  const char* newline;
+
+  if ((offset == 0) || (offset >= scan->len))
   {
-    if (matchpattern(pattern, text--, matchlength))
-      return 1;
-    (*matchlength)--;
+    return (offset == 0) ? 0 : scan->len;
   }
-
-  *matchlength = prelen;
-  return 0;
+  newline = (const char*) memchr(scan->buf + offset - 1, '\n', scan->len - offset + 1);
+  return (newline == 0) ? scan->len : (size_t) (newline - scan->buf) + 1;
 }
 
-static int matchplus(regex_t p, regex_t* pattern, const char* text, int* matchlength)
+/* The next piece to match, scan->npieces or more once there are none left. */
+static size_t scantake(scan_t* scan)
 {
-  const char* prepoint = text;
-  while ((text[0] != '\0') && matchone(p, *text))
-  {
-    text++;
-    (*matchlength)++;
-  }
-  while (text > prepoint)
-  {
-    if (matchpattern(pattern, text--, matchlength))
-      return 1;
-    (*matchlength)--;
-  }
+#if (RE_THREADS > 0)
+  return __atomic_fetch_add(&scan->next, 1, __ATOMIC_RELAXED);
+#else
+  return scan->next++;
+#endif
+}
 
-  return 0;
+/* Have the matches of the pieces before piece been reported? */
+static int scanisturn(scan_t* scan, size_t piece)
+{
+#if (RE_THREADS > 0)
+  return (__atomic_load_n(&scan->turn, __ATOMIC_ACQUIRE) == piece);
+#else
+  return (scan->turn == piece);
+#endif
 }
 
-static int matchquestion(regex_t p, regex_t* pattern, const char* text, int* matchlength)
+/* Wait until the matches of the pieces before piece have been reported. */
+static void scanwait(scan_t* scan, size_t piece)
 {
-  if (p.type == UNUSED)
-    return 1;
-  if (matchpattern(pattern, text, matchlength))
-      return 1;
-  if (*text && matchone(p, *text++))
+#if (RE_THREADS > 0)
+  if (!scanisturn(scan, piece))
   {
-    if (matchpattern(pattern, text, matchlength))
+    pthread_mutex_lock(&scan->lock);
+    while (!scanisturn(scan, piece))
     {
-      (*matchlength)++;
-      return 1;
+      pthread_cond_wait(&scan->turned, &scan->lock);
     }
+    pthread_mutex_unlock(&scan->lock);
   }
-  return 0;
+#else
+  (void) scan;
+  (void) piece;
+#endif
 }
 
-
-#if 0
-
-/* Recursive matching */
-static int matchpattern(regex_t* pattern, const char* text, int *matchlength)
+/* Hold a match of piece back until it is its turn. Returns 0 if there is no memory for it. */
+static int scanhold(scan_t* scan, size_t piece, const scanmatch_t* match)
 {
-  int pre = *matchlength;
-  if ((pattern[0].type == UNUSED) || (pattern[1].type == QUESTIONMARK))
+  scanpiece_t* p;
+
+  if (scan->pieces == 0)
   {
-    return matchquestion(pattern[1], &pattern[2], text, matchlength);
+    return 0;
   }
-  else if (pattern[1].type == STAR)
+  p = &scan->pieces[piece];
+  if (p->nheld == p->capacity)
   {
-    return matchstar(pattern[0], &pattern[2], text, matchlength);
+    const size_t capacity = (p->capacity == 0) ? SCAN_HELD : 2 * p->capacity;
+    scanmatch_t* held;
+
+    if (capacity > (size_t) -1 / sizeof(scanmatch_t))
+    {
+      return 0;
+    }
+    held = (scanmatch_t*) realloc(p->held, capacity * sizeof(scanmatch_t));
+    if (held == 0)
+    {
+      return 0;
+    }
+    p->held = held;
+    p->capacity = capacity;
   }
-  else if (pattern[1].type == PLUS)
+  p->held[p->nheld++] = *match;
+  return 1;
+}
+
+/* Report the matches piece held back, once it is its turn. */
+static void scanreport(scan_t* scan, size_t piece)
+{
+  scanpiece_t* p;
+  size_t i;
+
+  if (scan->pieces == 0)
   {
-    return matchplus(pattern[0], &pattern[2], text, matchlength);
+    return;
   }
-  else if ((pattern[0].type == END) && pattern[1].type == UNUSED)
+  p = &scan->pieces[piece];
+  for (i = 0; i < p->nheld; ++i)
   {
-    return text[0] == '\0';
+    scan->callback(scan->context, p->held[i].linestart, p->held[i].linelength, p->held[i].matchstart, p->held[i].matchlength);
   }
-  else if ((text[0] != '\0') && matchone(pattern[0], text[0]))
+  free(p->held);
+  p->held = 0;
+  p->nheld = 0;
+  p->capacity = 0;
+}
+
+/* All lines of piece have been matched. Once it is its turn, the pieces from it on that are done are reported,
+   by one thread at a time, the others leave them to it. */
+static void scandone(scan_t* scan, size_t piece, size_t matched)
+{
+#if (RE_THREADS > 0)
+  pthread_mutex_lock(&scan->lock);
+  scan->matched += matched;
+  if (scan->pieces == 0)
   {
-    (*matchlength)++;
-    return matchpattern(&pattern[1], text+1);
+    __atomic_store_n(&scan->turn, piece + 1, __ATOMIC_RELEASE);
   }
   else
   {
-    *matchlength = pre;
-    return 0;
-  }
-}
+    scan->pieces[piece].done = 1;
+    if (!scan->reporting)
+    {
+      scan->reporting = 1;
+      while ((scan->turn < scan->npieces) && scan->pieces[scan->turn].done)
+      {
+        const size_t turn = scan->turn;
 
+        pthread_mutex_unlock(&scan->lock);
+        scanreport(scan, turn);
+        pthread_mutex_lock(&scan->lock);
+        __atomic_store_n(&scan->turn, turn + 1, __ATOMIC_RELEASE);
+      }
+      scan->reporting = 0;
+    }
+  }
+  pthread_cond_broadcast(&scan->turned);
+  pthread_mutex_unlock(&scan->lock);
 #else
+  (void) piece;
+  scan->matched += matched;
+  scan->turn += 1;
+#endif
+}
 
-/* Iterative matching */
-static int matchpattern(regex_t* pattern, const char* text, int* matchlength)
+/* Take pieces until there are none left, matching them line by line. */
+static void scanpieces(scan_t* scan)
 {
-  int pre = *matchlength;
-  do
+  const re_info_t* pinfo = info(scan->pattern);
+  size_t piece;
+
+  while ((piece = scantake(scan)) < scan->npieces)
   {
-    if ((pattern[0].type == UNUSED) || (pattern[1].type == QUESTIONMARK))
-    {
-      return matchquestion(pattern[0], &pattern[2], text, matchlength);
-    }
-    else if (pattern[1].type == STAR)
-    {
-      return matchstar(pattern[0], &pattern[2], text, matchlength);
-    }
-    else if (pattern[1].type == PLUS)
-    {
-      return matchplus(pattern[0], &pattern[2], text, matchlength);
-    }
-    else if ((pattern[0].type == END) && pattern[1].type == UNUSED)
-    {
-      return (text[0] == '\0');
-    }
-/*  Branching is not working properly
-    else if (pattern[1].type == BRANCH)
+    const size_t end = scanlinestart(scan, (piece + 1) * scan->piecesize);
+    size_t pos = scanlinestart(scan, piece * scan->piecesize);
+    const char* required = 0;
+    size_t matched = 0;
+    int turn = 0;     /* the pieces before are reported, so are the matches of this one as they are found */
+
+    while (pos < end)
     {
-      return (matchpattern(pattern, text) || matchpattern(&pattern[2], text));
+      const char* lineend = (const char*) memchr(scan->buf + pos, '\n', end - pos);
+      size_t linelength;
+      int m;
+      int length;
+
+      if (lineend == 0)
+      {
+        lineend = scan->buf + end;
+      }
+
+      /* Lines without the literal that every match contains are skipped over in one go */
+      if (pinfo->requiredlength > 0)
+      {
+        if ((required == 0) || (required < scan->buf + pos))
+        {
+          required = findliteral(pinfo->required, pinfo->requiredlength, scan->buf + pos, scan->buf + end);
+          if (required == 0)
+          {
+            break;
+          }
+        }
+        if (required >= lineend)
+        {
+          const size_t linestart = pos;
+
+          for (pos = (size_t) (required - scan->buf); (pos > linestart) && (scan->buf[pos - 1] != '\n'); --pos)
+          {
+          }
+          lineend = (const char*) memchr(required, '\n', end - (size_t) (required - scan->buf));
+          if (lineend == 0)
+          {
+            lineend = scan->buf + end;
+          }
+        }
+      }
+
+      /* re_matchpn() takes int lengths: a line beyond INT_MAX bytes is matched on its first INT_MAX */
+      linelength = (size_t) (lineend - (scan->buf + pos));
+      m = re_matchpn(scan->pattern, scan->buf + pos, (linelength > INT_MAX) ? INT_MAX : (int) linelength, &length);
+      if (m != -1)
+      {
+        scanmatch_t match;
+
+        match.linestart = pos;
+        match.linelength = linelength;
+        match.matchstart = pos + (size_t) m;
+        match.matchlength = (size_t) length;
+        matched += 1;
+
+        if (!turn && scanisturn(scan, piece))
+        {
+          scanreport(scan, piece);
+          turn = 1;
+        }
+        if (!turn && !scanhold(scan, piece, &match))
+        {
+          /* No memory to hold it back: wait for the turn of this piece instead */
+          scanwait(scan, piece);
+          scanreport(scan, piece);
+          turn = 1;
+        }
+        if (turn)
+        {
+          scan->callback(scan->context, match.linestart, match.linelength, match.matchstart, match.matchlength);
+        }
+      }
+      pos = (size_t) (lineend - scan->buf) + 1;
     }
-*/
-  (*matchlength)++;
-  }
-  while ((text[0] != '\0') && matchone(*pattern++, *text++));
 
-  *matchlength = pre;
-  return 0;
+    scandone(scan, piece, matched);
+  }
 }
-
-#endif
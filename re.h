@@ -36,6 +36,51 @@
 #define RE_DOT_MATCHES_NEWLINE 1
 #endif
 
+#ifndef RE_SIMD
+/* Define to 0 if you DON'T want runs of '*' and '+' scanned with SSSE3/AVX2 on x86 (picked at run-time) */
+#define RE_SIMD 1
+#endif
+
+/* Matching engines, see re_set_engine() */
+#define RE_ENGINE_BACKTRACK 0   /* recursive backtracking, no memory beyond the call-stack       */
+#define RE_ENGINE_PIKEVM    1   /* Pike VM: O(pattern x text) time, state-lists on the call-stack */
+
+#ifndef RE_CACHE_SIZE
+/* Define to the number of compiled patterns re_match() and re_matchn() keep around (least recently used
+   ones are dropped), so repeated patterns aren't compiled again. Needs pthreads. 0 compiles on every call. */
+#define RE_CACHE_SIZE 0
+#endif
+
+#ifndef RE_THREADS
+/* Define to 1 to have re_match_batch() spread its work over several threads. Needs pthreads.
+   0 matches the batch in the calling thread. */
+#define RE_THREADS 0
+#endif
+
+#ifndef RE_JIT
+/* Define to 1 to have re_jit() compile patterns to native code on x86-64 (Linux and FreeBSD, needs mmap()).
+   0 leaves the JIT out; re_jit() then does nothing and all matching is interpreted. */
+#define RE_JIT 0
+#endif
+
+#ifndef RE_STATS
+/* Define to 1 to have re_matchpn_stats() count what the matchers do. 0 leaves the counting out of all matching. */
+#define RE_STATS 0
+#endif
+
+#ifndef RE_MAX_SYMBOLS
+/* Most symbols a pattern of re_compile_into() or a pattern set may have; longer ones don't compile. The matchers
+   keep state per symbol on the call-stack, so this bounds how much of it a match takes (up to 64 kB at 1024). */
+#define RE_MAX_SYMBOLS 1024
+#endif
+
+#ifndef RE_DEFAULT_ENGINE
+/* Engine of newly compiled patterns */
+#define RE_DEFAULT_ENGINE RE_ENGINE_BACKTRACK
+#endif
+
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -46,10 +91,74 @@ extern "C"{
 typedef struct regex_t* re_t;
 
 
-/* Compile regex string pattern to a regex_t-array. */
+/* Compile regex string pattern to a regex_t-array. Returns 0 if the pattern is invalid, or has more than
+   29 symbols (chars, classes, quantifiers and anchors), all its static buffer holds; use re_compile_into() for those. */
 re_t re_compile(const char* pattern);
 
 
+/* Number of bytes re_compile_into() needs for pattern, or 0 if the pattern is invalid or has more than RE_MAX_SYMBOLS symbols. */
+size_t re_compiled_size(const char* pattern);
+
+
+/* Reentrant re_compile(): compile pattern into caller-owned storage instead of the static buffer.
+   buf must be aligned for a pointer (e.g. from malloc) and hold at least re_compiled_size(pattern) bytes.
+   Returns 0 if the pattern is invalid, has more than RE_MAX_SYMBOLS symbols or the buffer is too small. */
+re_t re_compile_into(const char* pattern, void* buf, size_t bufsize);
+
+
+/* Select the engine (RE_ENGINE_...) used to match a compiled pattern.
+   Both engines find the same matches; the Pike VM never backtracks, so it is safe on untrusted text. */
+void re_set_engine(re_t pattern, int engine);
+
+
+/* Compile pattern to x86-64 code in an executable page of its own (see RE_JIT): the backtracking engine then
+   runs that code instead of interpreting the pattern, and finds the same matches. Matches with a budget, memo
+   or stats, the Pike VM and patterns ending in '$' without a leading '^' stay interpreted. Returns 1 if the pattern was compiled,
+   0 if it is left to the interpreter (RE_JIT is 0, another CPU, or no executable memory to be had).
+   The code stays until re_jit_free(), which must come before the pattern's storage is reused or freed;
+   re_compile() reuses its buffer on every call, so patterns for re_jit() are best from re_compile_into(). */
+int re_jit(re_t pattern);
+void re_jit_free(re_t pattern);
+
+
+/* Typedef'd pointer to the state-cache of a lazy DFA. */
+typedef struct re_dfa* re_dfa_t;
+
+
+/* Set up a lazy DFA for a compiled pattern: DFA-states are built while matching and cached in buf,
+   so bufsize caps its memory (a few kB is plenty for most patterns). buf must be aligned for a pointer.
+   Returns 0 if buf can't hold at least two states. The cache is written by every match, so each
+   thread needs a DFA of its own. */
+re_dfa_t re_dfa_init(re_t pattern, void* buf, size_t bufsize);
+
+
+/* Same as re_matchpn() on the pattern of dfa: a single table-lookup per byte once its states are cached.
+   A full cache is flushed; if it fills up faster than it pays off, the rest of the text is stepped through
+   like the Pike VM does, from the threads at hand, without caching the states. */
+int re_dfa_matchn(re_dfa_t dfa, const char* text, int textlength, int* matchlength);
+
+
+/* Typedef'd pointer to a set of patterns that are matched together. */
+typedef struct re_set* re_set_t;
+
+
+/* Smallest buffer re_set_compile() accepts for these patterns, or 0 if one of them is invalid (see RE_MAX_SYMBOLS).
+   Whatever buf holds beyond that caches DFA-states, so more (tens of kB) makes matching faster. */
+size_t re_set_size(const char** patterns, int npatterns);
+
+
+/* Compile npatterns patterns into buf, to find out in one pass over a text which of them match it.
+   Plain strings among them are looked for all at once with Aho-Corasick. buf must be aligned for a pointer.
+   Returns 0 if a pattern is invalid or bufsize is below re_set_size(). The cache in buf is written by every match, so each thread needs a set of its own. */
+re_set_t re_set_compile(const char** patterns, int npatterns, void* buf, size_t bufsize);
+
+
+/* Store the indices of the patterns that match text in ids, in ascending order (ids needs room for all of
+   them), and return how many there are. A pattern matches if re_matchpn() wouldn't return -1 for it. */
+int re_set_matchn(re_set_t set, const char* text, int textlength, int* ids);
+int re_set_match(re_set_t set, const char* text, int* ids);
+
+
 /* Find matches of the compiled pattern inside text. */
 int re_matchp(re_t pattern, const char* text, int* matchlength);
 
@@ -58,6 +167,119 @@ int re_matchp(re_t pattern, const char* text, int* matchlength);
 int re_match(const char* pattern, const char* text, int* matchlength);
 
 
+/* Length-delimited variants of re_matchp() and re_match(): text holds textlength bytes.
+   It needs no '\0'-terminator and may contain '\0'-bytes, which are matched like any other char. */
+int re_matchpn(re_t pattern, const char* text, int textlength, int* matchlength);
+int re_matchn(const char* pattern, const char* text, int textlength, int* matchlength);
+
+
+/* Returned by re_matchp_budget() and re_matchpn_budget() when they gave up before finding out. */
+#define RE_BUDGET_EXCEEDED (-2)
+
+/* re_matchp() and re_matchpn() with a bound on the work they do, for text that may be hostile: after maxsteps
+   steps of the matcher (0 for no limit), or once *cancel is set (unless cancel is NULL), they stop and return
+   RE_BUDGET_EXCEEDED. A step is a char compared or a place backtracked to; for the Pike VM, a thread moved on.
+   The flag is looked at every 1024 steps, so another thread can set it to cancel a match that takes too long. */
+int re_matchp_budget(re_t pattern, const char* text, int* matchlength, unsigned long maxsteps, const volatile int* cancel);
+int re_matchpn_budget(re_t pattern, const char* text, int textlength, int* matchlength, unsigned long maxsteps, const volatile int* cancel);
+
+
+/* What the matchers did in a call of re_matchpn_stats() or re_find_next_stats(), see RE_STATS. */
+typedef struct
+{
+  unsigned long starts;         /* places in the text a match was tried from                  */
+  unsigned long matchpatterns;  /* calls of the backtracker's matchpattern()                  */
+  unsigned long matchones;      /* chars tested against a pattern symbol                      */
+  unsigned long backtracks;     /* places '*' and '+' backed off to, after the greedy run     */
+  unsigned long maxdepth;       /* deepest nesting of matchpattern() calls                    */
+  unsigned long scanned;        /* bytes looked through for the required literal or a start   */
+} re_match_stats_t;
+
+/* re_matchpn(), counting what the matchers do in *stats; all zero if RE_STATS is 0. Slow calls show whether the
+   time went into many places tried (starts) or backtracking at one of them (backtracks, maxdepth). */
+int re_matchpn_stats(re_t pattern, const char* text, int textlength, int* matchlength, re_match_stats_t* stats);
+
+
+/* Bytes of memo re_matchpn_memo() needs to cover all of a text of textlength bytes: a bit per pattern symbol and offset.
+   0 if pattern is 0. */
+size_t re_memo_size(re_t pattern, int textlength);
+
+/* re_matchpn() with the backtracker remembering in memo each symbol and offset it failed to match the rest of the
+   pattern from, so it tries none of them twice: the same match, found in time polynomial in textlength rather than
+   exponential. memo is cleared first; with less than re_memo_size() bytes, offsets beyond what fits aren't remembered. */
+int re_matchpn_memo(re_t pattern, const char* text, int textlength, int* matchlength, void* memo, size_t memosize);
+
+
+/* Find the next match in text from *cursor on, to iterate over all of them: start with *cursor at 0.
+   Returns 1 with the match in *matchstart and *matchlength and *cursor moved past it (past an empty match, a
+   byte further), or 0 once there are no more (or *cursor is outside of text). Matches are those of re_matchpn(); '^'
+   only matches at offset 0. The prefilters never look past the end of the match they lead to, so a pass over all
+   matches scans each byte about once for the required literal and once for a place to start; only the matchers
+   read on past a match. */
+int re_find_next(re_t pattern, const char* text, int textlength, int* cursor, int* matchstart, int* matchlength);
+
+/* re_find_next(), adding what the matchers did to *stats, which isn't cleared first, so it sums up a whole pass
+   (maxdepth is the deepest of all). Nothing is added if RE_STATS is 0. */
+int re_find_next_stats(re_t pattern, const char* text, int textlength, int* cursor, int* matchstart, int* matchlength, re_match_stats_t* stats);
+
+
+/* Match pattern against each of n texts, of lengths[i] bytes (or '\0'-terminated if lengths is NULL), as
+   re_matchpn() would: results[2 * i] gets the match-offset in texts[i] or -1, results[2 * i + 1] its length.
+   With RE_THREADS, nthreads threads share the work (0 for one per CPU), as many as there is work for: a short batch
+   stays on the calling thread. Returns the number of texts matched. */
+int re_match_batch(re_t pattern, const char** texts, const int* lengths, int n, int* results, int nthreads);
+
+
+/* Called for each line that matches in re_scan_parallel(), in order: the offsets and lengths of the line
+   (without its '\n') and of the match in it, counted from the start of the buffer. */
+typedef void (*re_scan_callback_t)(void* context, size_t linestart, size_t linelength, size_t matchstart, size_t matchlength);
+
+/* Match pattern against each line of buf, as re_matchpn() would, and report the lines that match. With RE_THREADS,
+   nthreads threads (0 for one per CPU) take pieces of buf that start and end at a line; callback is still called
+   from one thread at a time, in the order of the lines; matches found ahead of that are held back with malloc().
+   Lines beyond INT_MAX bytes are matched on their first INT_MAX. Returns the number of lines that matched. */
+size_t re_scan_parallel(re_t pattern, const char* buf, size_t len, int nthreads, re_scan_callback_t callback, void* context);
+
+
+/* Typedef'd pointer to a search through text that arrives in pieces. */
+typedef struct re_stream* re_stream_t;
+
+/* Called for each match of a stream, in order: its offset from the start of the stream and its length. */
+typedef void (*re_stream_callback_t)(void* context, size_t matchstart, size_t matchlength);
+
+
+/* Bytes re_stream_init() needs for pattern, keeping up to lookbehind bytes of text (at least 1). Text is only
+   kept while a match has been found but a longer one may still follow, from the end of the shorter one on:
+   for \d+ that is 2 bytes (the last digit and the byte after it), for a.*b all of the rest of the stream.
+   0 if pattern is 0. */
+size_t re_stream_size(re_t pattern, size_t lookbehind);
+
+
+/* Start a stream in buf (aligned for a pointer), to report every match of pattern in the text fed to it.
+   Matches are those re_matchpn() finds, each searched for after the end of the one before (after an empty
+   one, a byte further). '^' anchors at the start of the stream. Returns 0 if bufsize is below re_stream_size(). */
+re_stream_t re_stream_init(re_t pattern, void* buf, size_t bufsize, re_stream_callback_t callback, void* context);
+
+
+/* Feed the next length bytes of text, down to one at a time, then call re_stream_finish() at the end of it.
+   Both return the number of matches they reported, or -1 once a match had to wait for more text than fits. */
+int re_stream_feed(re_stream_t stream, const char* text, int length);
+int re_stream_finish(re_stream_t stream);
+
+
+/* Counters of the pattern-cache behind re_match() and re_matchn(), see RE_CACHE_SIZE. */
+typedef struct
+{
+  unsigned long hits;       /* calls that found their pattern compiled already */
+  unsigned long misses;     /* calls that had to compile it                    */
+  unsigned long evictions;  /* compiled patterns dropped to make room          */
+} re_cache_stats_t;
+
+/* Read the cache-counters; all zero if RE_CACHE_SIZE is 0. With the cache enabled,
+   re_match() and re_matchn() can be called from several threads at once. */
+void re_cache_stats(re_cache_stats_t* stats);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,386 @@
+/*
+ *
+ * C++ wrapper of the regex-module, for patterns that are known at compile time.
+ *
+ * re::compile() parses a pattern literal into an array of nodes in a constant expression,
+ * so there is nothing to compile at startup, and matching is inline code the compiler
+ * can specialize for the pattern:
+ *
+ *   constexpr auto number = re::compile("\\d+");
+ *   int length;
+ *   int idx = number.match("took 25ms", &length);    // idx 5, length 2
+ *
+ * An invalid pattern in a constexpr variable is a compile error ("call to non-constexpr
+ * function re::detail::invalid_pattern"). Outside constant expressions it gives a pattern
+ * that never matches, like re_compile() returning 0.
+ *
+ * Matches are the same as re_matchp() finds with the backtracking engine, and obey the
+ * same RE_DOT_MATCHES_NEWLINE. Needs C++14.
+ *
+ */
+
+#ifndef _TINY_REGEX_CPP
+#define _TINY_REGEX_CPP
+
+
+#include <stddef.h>
+#include "re.h"
+
+
+namespace re
+{
+
+namespace detail
+{
+
+enum { UNUSED, DOT, BEGIN, END, QUESTIONMARK, STAR, PLUS, CHAR, CLASS };
+
+struct node
+{
+  unsigned char type = UNUSED;
+  char ch = 0;                  /* the char of CHAR, 0 for the others         */
+  unsigned char ccl[32] = {};   /* bit per char of CLASS, \d \w \s and friends */
+};
+
+/* Not constexpr: reaching it in a constant expression is what turns an invalid pattern into a compile error */
+inline void invalid_pattern()
+{
+}
+
+constexpr int isdigit(char c)
+{
+  return ((c >= '0') && (c <= '9'));
+}
+constexpr int isalphanum(char c)
+{
+  return ((c == '_') || isdigit(c) || ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')));
+}
+constexpr int iswhitespace(char c)
+{
+  return ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f') || (c == '\v'));
+}
+
+constexpr int matchmetachar(char c, char m)
+{
+  switch (m)
+  {
+    case 'd': return  isdigit(c);
+    case 'D': return !isdigit(c);
+    case 'w': return  isalphanum(c);
+    case 'W': return !isalphanum(c);
+    case 's': return  iswhitespace(c);
+    case 'S': return !iswhitespace(c);
+    default:  return (c == m);
+  }
+}
+
+constexpr int ismetachar(char c)
+{
+  return ((c == 's') || (c == 'S') || (c == 'w') || (c == 'W') || (c == 'd') || (c == 'D'));
+}
+
+/* Same as matchcharclass() in re.c: is c in the class [str, end), as written in the pattern? */
+constexpr int matchcharclass(char c, const char* str, const char* end)
+{
+  const char* begin = str;
+
+  for (; str < end; ++str)
+  {
+    if (    (c != '-') && (str[0] != '-') && (str + 2 < end) && (str[1] == '-')
+         && (c >= str[0]) && (c <= str[2]))
+    {
+      return 1;
+    }
+    else if (str[0] == '\\')
+    {
+      str += 1;
+      if (matchmetachar(c, str[0]) || ((c == str[0]) && !ismetachar(c)))
+      {
+        return 1;
+      }
+    }
+    else if (c == str[0])
+    {
+      return (c != '-') || (str == begin) || (str + 1 == end);
+    }
+  }
+  return 0;
+}
+
+} /* namespace detail */
+
+
+/* A compiled pattern of at most N - 1 symbols */
+template <size_t N>
+class pattern
+{
+public:
+  constexpr explicit pattern(const char* str)
+    : m_nodes(), m_valid(0)
+  {
+    m_valid = parse(str);
+    if (!m_valid)
+    {
+      detail::invalid_pattern();
+    }
+  }
+
+  /* 0 if the pattern was invalid, or had more symbols than fit */
+  constexpr int valid() const
+  {
+    return m_valid;
+  }
+
+  /* Same as re_matchp() */
+  constexpr int match(const char* text, int* matchlength) const
+  {
+    int textlength = 0;
+
+    while (text[textlength] != '\0')
+    {
+      textlength += 1;
+    }
+    return matchn(text, textlength, matchlength);
+  }
+
+  /* Same as re_matchpn() */
+  constexpr int matchn(const char* text, int textlength, int* matchlength) const
+  {
+    const char* end = text + textlength;
+    int idx = 0;
+
+    *matchlength = 0;
+    if (!m_valid)
+    {
+      return -1;
+    }
+    if (m_nodes[0].type == detail::BEGIN)
+    {
+      return (matchpattern(1, text, end, matchlength) ? 0 : -1);
+    }
+    do
+    {
+      if (matchpattern(0, text + idx, end, matchlength))
+      {
+        return (idx == textlength) ? -1 : idx;
+      }
+    }
+    while (idx++ != textlength);
+
+    return -1;
+  }
+
+private:
+  detail::node m_nodes[N];
+  int m_valid;
+
+  /* Same as compile() in re.c */
+  constexpr int parse(const char* str)
+  {
+    size_t i = 0;
+    size_t j = 0;
+
+    while (str[i] != '\0')
+    {
+      detail::node obj = detail::node();
+      int k = 0;
+
+      if (j + 1 >= N)
+      {
+        return 0;
+      }
+      obj.type = detail::UNUSED;  /* a lone '\\' at the end of the pattern leaves this in place */
+      switch (str[i])
+      {
+        case '^': { obj.type = detail::BEGIN;        } break;
+        case '$': { obj.type = detail::END;          } break;
+        case '.': { obj.type = detail::DOT;          } break;
+        case '*': { obj.type = detail::STAR;         } break;
+        case '+': { obj.type = detail::PLUS;         } break;
+        case '?': { obj.type = detail::QUESTIONMARK; } break;
+
+        case '\\':
+        {
+          if (str[i+1] != '\0')
+          {
+            i += 1;
+            if (detail::ismetachar(str[i]))
+            {
+              obj.type = detail::CLASS;
+              for (k = 1; k < 256; ++k)
+              {
+                if (detail::matchmetachar((char) k, str[i]))
+                {
+                  obj.ccl[k >> 3] |= (unsigned char) (1 << (k & 7));
+                }
+              }
+              if ((str[i] == 'D') || (str[i] == 'W') || (str[i] == 'S'))
+              {
+                obj.ccl[0] |= 1;
+              }
+            }
+            else
+            {
+              obj.type = detail::CHAR;
+              obj.ch = str[i];
+            }
+          }
+        } break;
+
+        case '[':
+        {
+          const int inverted = (str[i+1] == '^');
+          const char* begin = 0;
+
+          if (inverted)
+          {
+            i += 1;
+            if (str[i+1] == '\0')
+            {
+              return 0;
+            }
+          }
+          begin = &str[i+1];
+          while ((str[++i] != ']') && (str[i] != '\0'))
+          {
+            if (str[i] == '\\')
+            {
+              if (str[i+1] == '\0')
+              {
+                return 0;
+              }
+              i += 1;
+            }
+          }
+          if (str[i] == '\0')
+          {
+            return 0;
+          }
+          obj.type = detail::CLASS;
+          for (k = 1; k < 256; ++k)
+          {
+            if (detail::matchcharclass((char) k, begin, &str[i]) != inverted)
+            {
+              obj.ccl[k >> 3] |= (unsigned char) (1 << (k & 7));
+            }
+          }
+          if (inverted)
+          {
+            obj.ccl[0] |= 1; /* '\0' is never part of a class */
+          }
+        } break;
+
+        default:
+        {
+          obj.type = detail::CHAR;
+          obj.ch = str[i];
+        } break;
+      }
+      m_nodes[j] = obj;
+      i += 1;
+      j += 1;
+    }
+    m_nodes[j] = detail::node();
+    m_nodes[j].type = detail::UNUSED;
+    return 1;
+  }
+
+  constexpr int matchone(const detail::node& p, char c) const
+  {
+    const unsigned char u = (unsigned char) c;
+
+    switch (p.type)
+    {
+      case detail::DOT:   return (RE_DOT_MATCHES_NEWLINE == 1) || ((c != '\n') && (c != '\r'));
+      case detail::CLASS: return (p.ccl[u >> 3] >> (u & 7)) & 1;
+      default:            return (p.ch == c);
+    }
+  }
+
+  /* The quantifiers below mirror matchquestion(), matchstar() and matchplus() in re.c,
+     backing off by count so no pointer goes in front of the text */
+  constexpr int matchquestion(size_t p, const char* text, const char* end, int* matchlength) const
+  {
+    if (m_nodes[p].type == detail::UNUSED)
+    {
+      return 1;
+    }
+    if (matchpattern(p + 2, text, end, matchlength))
+    {
+      return 1;
+    }
+    if ((text != end) && matchone(m_nodes[p], *text) && matchpattern(p + 2, text + 1, end, matchlength))
+    {
+      (*matchlength)++;
+      return 1;
+    }
+    return 0;
+  }
+
+  constexpr int matchstar(size_t p, int least, const char* text, const char* end, int* matchlength) const
+  {
+    const int prelen = *matchlength;
+    int run = 0;
+
+    while ((text + run != end) && matchone(m_nodes[p], text[run]))
+    {
+      run += 1;
+    }
+    *matchlength += run;
+    for (; run >= least; --run)
+    {
+      if (matchpattern(p + 2, text + run, end, matchlength))
+      {
+        return 1;
+      }
+      (*matchlength)--;
+    }
+    *matchlength = prelen;
+    return 0;
+  }
+
+  constexpr int matchpattern(size_t p, const char* text, const char* end, int* matchlength) const
+  {
+    const int pre = *matchlength;
+
+    do
+    {
+      if ((m_nodes[p].type == detail::UNUSED) || (m_nodes[p+1].type == detail::QUESTIONMARK))
+      {
+        if (matchquestion(p, text, end, matchlength))
+          return 1;
+        break;
+      }
+      else if ((m_nodes[p+1].type == detail::STAR) || (m_nodes[p+1].type == detail::PLUS))
+      {
+        if (matchstar(p, (m_nodes[p+1].type == detail::PLUS), text, end, matchlength))
+          return 1;
+        break;
+      }
+      else if ((m_nodes[p].type == detail::END) && (m_nodes[p+1].type == detail::UNUSED))
+      {
+        if (text == end)
+          return 1;
+        break;
+      }
+      (*matchlength)++;
+    }
+    while ((text != end) && matchone(m_nodes[p++], *text++));
+
+    *matchlength = pre;
+    return 0;
+  }
+};
+
+
+/* Pattern of a string literal: it has room for all the symbols a literal of that length can hold */
+template <size_t N>
+constexpr pattern<N> compile(const char (&str)[N])
+{
+  return pattern<N>(str);
+}
+
+} /* namespace re */
+
+
+#endif /* ifndef _TINY_REGEX_CPP */
@@ -0,0 +1,321 @@
+#!/usr/bin/env python
+
+"""
+  This program turns regex-patterns known at build time into C functions that match them
+  without interpreting a compiled pattern, the way re2c does for lexers:
+
+    python scripts/regex_codegen.py [-o file.c] name pattern [name pattern ...]
+
+  Each pattern becomes a function with the contract of re_matchp():
+
+    int name(const char* text, int* matchlength);
+
+  It returns the index of the first match in the '\\0'-terminated text, or -1, and finds the same
+  matches as re_matchp() with the backtracking engine. The pattern is parsed like re_compile() does,
+  and each place in it the backtracker can start matchpattern() from becomes a function of its own:
+  runs of chars are tested in one condition, classes against an inline bitmap, and '*', '+' and '?'
+  call the function for the rest of the pattern. Invalid patterns are reported and give exit-code 1.
+"""
+
+
+import sys
+
+
+UNUSED, DOT, BEGIN, END, QUESTIONMARK, STAR, PLUS, CHAR, CLASS = range(9)
+
+
+def signed(c):
+  """A byte as the (signed) char that compile() compares class-ranges with"""
+  return c - 256 if c >= 128 else c
+
+
+def isdigit(c):
+  return 48 <= c <= 57
+
+
+def isalphanum(c):
+  return isdigit(c) or (65 <= c <= 90) or (97 <= c <= 122) or (c == 95)
+
+
+def iswhitespace(c):
+  return c in (9, 10, 11, 12, 13, 32)
+
+
+def matchmetachar(c, m):
+  tests = { 'd': isdigit, 'w': isalphanum, 's': iswhitespace }
+  if m.lower() in tests and m in "dDwWsS":
+    return tests[m.lower()](c) != m.isupper()
+  return c == ord(m)
+
+
+def matchcharclass(c, cls):
+  """Same as matchcharclass() in re.c: is byte c in the class cls, as written between the brackets?"""
+  i = 0
+  while i < len(cls):
+    if (c != 45) and (cls[i] != '-') and (i + 2 < len(cls)) and (cls[i + 1] == '-') \
+        and (signed(ord(cls[i])) <= signed(c) <= signed(ord(cls[i + 2]))):
+      return True
+    elif cls[i] == '\\':
+      i += 1
+      if matchmetachar(c, cls[i]) or ((c == ord(cls[i])) and chr(c) not in "sSwWdD"):
+        return True
+    elif c == ord(cls[i]):
+      return (c != 45) or (i == 0) or (i + 1 == len(cls))
+    i += 1
+  return False
+
+
+def bitmap(test):
+  """The bytes that test() accepts, as a bit per byte"""
+  bits = [0] * 32
+  for c in range(256):
+    if test(c):
+      bits[c >> 3] |= 1 << (c & 7)
+  return bits
+
+
+def compile(pattern):
+  """Parse pattern like compile() in re.c: a list of (type, char or bitmap), ending in UNUSED. None if invalid."""
+  escapes = { 'd': isdigit, 'w': isalphanum, 's': iswhitespace }
+  objects = []
+  i = 0
+  while i < len(pattern):
+    c = pattern[i]
+    obj = (UNUSED, 0)  # a lone '\\' at the end of the pattern leaves this in place
+    if c in "^$.*+?":
+      obj = ({ '^': BEGIN, '$': END, '.': DOT, '*': STAR, '+': PLUS, '?': QUESTIONMARK }[c], 0)
+    elif c == '\\':
+      if i + 1 < len(pattern):
+        i += 1
+        e = pattern[i]
+        if e in "dDwWsS":
+          obj = (CLASS, bitmap(lambda b, t=escapes[e.lower()], inv=e.isupper(): t(b) != inv))
+        else:
+          obj = (CHAR, ord(e))
+    elif c == '[':
+      inverted = (i + 1 < len(pattern)) and (pattern[i + 1] == '^')
+      if inverted:
+        i += 1
+        if i + 1 >= len(pattern):
+          return None
+      begin = i + 1
+      i += 1
+      while (i < len(pattern)) and (pattern[i] != ']'):
+        if pattern[i] == '\\':
+          if i + 1 >= len(pattern):
+            return None
+          i += 1
+        i += 1
+      if i >= len(pattern):
+        return None
+      cls = pattern[begin:i]
+      # '\0' is never part of a class, so it is in every inverted one
+      obj = (CLASS, bitmap(lambda b: inverted if (b == 0) else (matchcharclass(b, cls) != inverted)))
+    else:
+      obj = (CHAR, ord(c))
+    objects.append(obj)
+    i += 1
+  objects.append((UNUSED, 0))
+  return objects
+
+
+def charliteral(c):
+  if (32 <= c < 127) and chr(c) not in "'\\":
+    return "'%s'" % chr(c)
+  return "(char) 0x%02x" % c
+
+
+class Generator:
+  def __init__(self, name, objects):
+    self.name = name
+    self.objects = objects
+    self.out = []
+
+  def test(self, j, c):
+    """C-expression that is true if char c matches object j, as matchone() would"""
+    kind, arg = self.objects[j]
+    if kind == DOT:
+      return "(RE_DOT_MATCHES_NEWLINE || ((%s != '\\n') && (%s != '\\r')))" % (c, c)
+    if kind == CLASS:
+      return "((%s_class%d[(unsigned char) %s >> 3] >> ((unsigned char) %s & 7)) & 1)" % (self.name, j, c, c)
+    if kind == CHAR:
+      return "(%s == %s)" % (c, charliteral(arg))
+    return "(%s == '\\0')" % c  # any other symbol out of place only matches its (zero) char
+
+  def walk(self, i):
+    """Objects matched one char at a time from i on, and the object that ends the run"""
+    j = i
+    while True:
+      kind = self.objects[j][0]
+      if (kind == UNUSED) or (self.objects[j + 1][0] in (QUESTIONMARK, STAR, PLUS)):
+        return j
+      if (kind == END) and (self.objects[j + 1][0] == UNUSED):
+        return j
+      j += 1
+
+  def entries(self):
+    """Objects that matchpattern() can be called on"""
+    todo = [1 if self.objects[0][0] == BEGIN else 0]
+    done = []
+    while todo:
+      i = todo.pop()
+      if i in done:
+        continue
+      done.append(i)
+      j = self.walk(i)
+      if (self.objects[j][0] != UNUSED) and (self.objects[j + 1][0] in (QUESTIONMARK, STAR, PLUS)):
+        todo.append(j + 2)
+    return sorted(done)
+
+  def emit(self, line=""):
+    self.out.append(line)
+
+  def entry(self, i):
+    j = self.walk(i)
+    name = self.name
+    body = []
+    if j > i:
+      tests = " && ".join(self.test(k, "text[%d]" % (k - i)) for k in range(i, j))
+      body.append("if (!((end - text >= %d) && %s))" % (j - i, tests))
+      body.append("{")
+      body.append("  return 0;")
+      body.append("}")
+      body.append("text += %d;" % (j - i))
+      body.append("*matchlength += %d;" % (j - i))
+    kind = self.objects[j][0]
+    quantifier = self.objects[j + 1][0] if kind != UNUSED else None
+    if kind == UNUSED:
+      body.append("return 1;")
+    elif quantifier == QUESTIONMARK:
+      body.append("if (%s_at%d(text, end, matchlength))" % (name, j + 2))
+      body.append("{")
+      body.append("  return 1;")
+      body.append("}")
+      body.append("if ((text != end) && %s && %s_at%d(text + 1, end, matchlength))" % (self.test(j, "*text"), name, j + 2))
+      body.append("{")
+      body.append("  *matchlength += 1;")
+      body.append("  return 1;")
+      body.append("}")
+    elif quantifier in (STAR, PLUS):
+      # Greedy: the longest run first, then back off a char at a time
+      body.append("{")
+      body.append("  int n = 0;")
+      body.append("  while ((text + n != end) && %s)" % self.test(j, "text[n]"))
+      body.append("  {")
+      body.append("    n += 1;")
+      body.append("  }")
+      body.append("  *matchlength += n;")
+      body.append("  for (; n >= %d; --n)" % (0 if quantifier == STAR else 1))
+      body.append("  {")
+      body.append("    if (%s_at%d(text + n, end, matchlength))" % (name, j + 2))
+      body.append("    {")
+      body.append("      return 1;")
+      body.append("    }")
+      body.append("    *matchlength -= 1;")
+      body.append("  }")
+      body.append("}")
+    else:
+      body.append("if (text == end)")
+      body.append("{")
+      body.append("  return 1;")
+      body.append("}")
+    # Only a failed run of chars returns before touching matchlength; the rest restores it here
+    failing = body[-1] != "return 1;"
+    if failing:
+      body.append("*matchlength = pre;")
+      body.append("return 0;")
+    self.emit("static int %s_at%d(const char* text, const char* end, int* matchlength)" % (name, i))
+    self.emit("{")
+    if failing:
+      self.emit("  const int pre = *matchlength;")
+      self.emit()
+    for parameter in ("text", "end", "matchlength"):
+      if not any(parameter in line for line in body):
+        self.emit("  (void) %s;" % parameter)
+    for line in body:
+      self.emit("  " + line if line else "")
+    self.emit("}")
+    self.emit()
+
+  def generate(self, pattern):
+    name = self.name
+    entries = self.entries()
+    self.emit("/* %s */" % pattern.replace("*/", "*\\/"))
+    for j, (kind, arg) in enumerate(self.objects):
+      if kind == CLASS:
+        self.emit("static const unsigned char %s_class%d[32] =" % (name, j))
+        self.emit("{")
+        self.emit("  " + ", ".join("0x%02x" % b for b in arg[:16]) + ",")
+        self.emit("  " + ", ".join("0x%02x" % b for b in arg[16:]))
+        self.emit("};")
+    self.emit()
+    for i in entries:
+      self.emit("static int %s_at%d(const char* text, const char* end, int* matchlength);" % (name, i))
+    self.emit()
+    for i in entries:
+      self.entry(i)
+
+    self.emit("int %s(const char* text, int* matchlength)" % name)
+    self.emit("{")
+    self.emit("  const char* end = text + strlen(text);")
+    if self.objects[0][0] != BEGIN:
+      self.emit("  const char* start = text;")
+    self.emit()
+    self.emit("  *matchlength = 0;")
+    if self.objects[0][0] == BEGIN:
+      self.emit("  return %s_at1(text, end, matchlength) ? 0 : -1;" % name)
+    else:
+      first = self.objects[0][0]
+      if (first not in (UNUSED, END)) and (self.objects[1][0] not in (QUESTIONMARK, STAR)):
+        # The first symbol has to match a char, so skip those it doesn't
+        self.emit("  for (; text != end; ++text)")
+        self.emit("  {")
+        self.emit("    if (%s && %s_at0(text, end, matchlength))" % (self.test(0, "*text"), name))
+        self.emit("    {")
+        self.emit("      return (int) (text - start);")
+        self.emit("    }")
+        self.emit("  }")
+        self.emit("  return -1;")
+      else:
+        self.emit("  do")
+        self.emit("  {")
+        self.emit("    if (%s_at0(text, end, matchlength))" % name)
+        self.emit("    {")
+        self.emit("      return (text == end) ? -1 : (int) (text - start);")
+        self.emit("    }")
+        self.emit("  }")
+        self.emit("  while (text++ != end);")
+        self.emit("  return -1;")
+    self.emit("}")
+    self.emit()
+    return self.out
+
+
+def main(args):
+  output = sys.stdout
+  if args[:1] == ["-o"]:
+    output = open(args[1], "w")
+    args = args[2:]
+  if (len(args) == 0) or (len(args) % 2 != 0):
+    sys.stderr.write("usage: %s [-o file.c] name pattern [name pattern ...]\n" % sys.argv[0])
+    return 1
+
+  lines = []
+  for name, pattern in zip(args[0::2], args[1::2]):
+    objects = compile(pattern)
+    if objects is None:
+      sys.stderr.write("%s: invalid pattern '%s'\n" % (sys.argv[0], pattern))
+      return 1
+    lines += Generator(name, objects).generate(pattern)
+
+  output.write("/* Generated by scripts/regex_codegen.py: matchers with the contract of re_matchp(). */\n\n")
+  output.write("#include <string.h>\n\n")
+  output.write("#ifndef RE_DOT_MATCHES_NEWLINE\n#define RE_DOT_MATCHES_NEWLINE 1\n#endif\n\n\n")
+  output.write("\n".join(lines))
+  if output is not sys.stdout:
+    output.close()
+  return 0
+
+
+if __name__ == "__main__":
+  sys.exit(main(sys.argv[1:]))
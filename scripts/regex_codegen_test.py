@@ -0,0 +1,141 @@
+#!/usr/bin/env python
+
+"""
+  This program checks the matchers that scripts/regex_codegen.py generates against re_matchp().
+  The patterns are given via sys.argv: they are generated into one file, built together with re.c
+  and a driver that runs both on random text over the chars in the patterns, and on each prefix
+  of a few fixed texts. Any difference in the returned index or matchlength is printed.
+  The exit-code of the testing program, is used to determine test success.
+
+  This script is called by the Makefile when doing 'make test'
+"""
+
+
+import os
+import sys
+import shutil
+import tempfile
+from subprocess import call
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import regex_codegen
+
+
+NTEXTS = 20000
+
+driver = r"""
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+%(declarations)s
+
+static const char* patterns[] = { %(patterns)s };
+static int (*matchers[])(const char*, int*) = { %(matchers)s };
+static const char alphabet[] = %(alphabet)s;
+static const char* fixed[] = { "", "a", "aaab.c.", "  hello world \n", "1-2-1-1\\?", "took 25ms", "xx123faerdig" };
+
+static int check(int p, re_t re, const char* text)
+{
+  int expectedlength = 0;
+  int length = 0;
+  int expected = re_matchp(re, text, &expectedlength);
+  int m = matchers[p](text, &length);
+
+  if ((m != expected) || ((m != -1) && (length != expectedlength)))
+  {
+    printf("    FAIL : pattern '%%s' on '%%s' gives %%d (length %%d), re_matchp() %%d (length %%d)\n",
+           patterns[p], text, m, length, expected, expectedlength);
+    return 1;
+  }
+  return 0;
+}
+
+int main()
+{
+  static void* objects[1024];
+  char text[32];
+  int nfails = 0;
+  int p;
+  int n;
+  int i;
+
+  srand(1);
+  for (p = 0; p < (int) (sizeof(patterns) / sizeof(*patterns)); ++p)
+  {
+    re_t re = re_compile_into(patterns[p], objects, sizeof(objects));
+    int fails = 0;
+
+    re_set_engine(re, RE_ENGINE_BACKTRACK);
+    for (n = 0; n < (int) (sizeof(fixed) / sizeof(*fixed)); ++n)
+    {
+      for (i = 0; i <= (int) strlen(fixed[n]); ++i)
+      {
+        memcpy(text, fixed[n], i);
+        text[i] = '\0';
+        fails += check(p, re, text);
+      }
+    }
+    for (n = 0; n < %(ntexts)d; ++n)
+    {
+      const int textlength = rand() %% (int) (sizeof(text) - 1);
+
+      for (i = 0; i < textlength; ++i)
+      {
+        text[i] = alphabet[rand() %% (int) (sizeof(alphabet) - 1)];
+      }
+      text[textlength] = '\0';
+      fails += check(p, re, text);
+    }
+    printf("%%-35s%%4d/%%d tests succeeded \n", patterns[p], %(ntexts)d - fails, %(ntexts)d);
+    nfails += fails;
+  }
+  return (nfails == 0) ? 0 : 1;
+}
+"""
+
+
+def cstring(s):
+  return '"%s"' % "".join(("\\%03o" % ord(c)) if (c in "\"\\?") or not (32 <= ord(c) < 127) else c for c in s)
+
+
+if len(sys.argv) < 2:
+  print("")
+  print("usage: %s pattern [pattern ...]" % sys.argv[0])
+  print("")
+  sys.exit(-1)
+
+patterns = sys.argv[1:]
+names = ["match%d" % i for i in range(len(patterns))]
+alphabet = "".join(sorted(set("".join(patterns) + "aZ09 -_.\t\n\xe9")))
+root = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+tmp = tempfile.mkdtemp()
+
+try:
+  generated = os.path.join(tmp, "generated.c")
+  args = ["-o", generated]
+  for name, pattern in zip(names, patterns):
+    args += [name, pattern]
+  if regex_codegen.main(args) != 0:
+    sys.exit(1)
+
+  with open(os.path.join(tmp, "driver.c"), "w") as f:
+    f.write(driver % {
+      "declarations": "\n".join("int %s(const char* text, int* matchlength);" % name for name in names),
+      "patterns": ", ".join(cstring(pattern) for pattern in patterns),
+      "matchers": ", ".join(names),
+      "alphabet": cstring(alphabet),
+      "ntexts": NTEXTS,
+    })
+
+  prog = os.path.join(tmp, "test_codegen")
+  cc = os.environ.get("CC", "gcc")
+  ret = call([cc, "-O", "-Wall", "-Wextra", "-Werror", "-std=c99", "-I" + root, os.path.join(root, "re.c"),
+              generated, os.path.join(tmp, "driver.c"), "-o", prog])
+  if ret == 0:
+    ret = call([prog])
+finally:
+  shutil.rmtree(tmp)
+
+sys.exit(0 if ret == 0 else 1)
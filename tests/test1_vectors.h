@@ -0,0 +1,90 @@
+/*
+ * The hand-picked regex's of test1.c, shared with test_cpp.cpp: one
+ * TEST_VECTOR(OK or NOK, pattern, text, length of the match) per line,
+ * which the file including this defines.
+ */
+
+  TEST_VECTOR(OK,  "\\d",                       "5",                1)
+  TEST_VECTOR(OK,  "\\w+",                      "hej",              3)
+  TEST_VECTOR(OK,  "\\s",                       "\t \n",            1)
+  TEST_VECTOR(NOK, "\\S",                       "\t \n",            0)
+  TEST_VECTOR(OK,  "[\\s]",                     "\t \n",            1)
+  TEST_VECTOR(NOK, "[\\S]",                     "\t \n",            0)
+  TEST_VECTOR(NOK, "\\D",                       "5",                0)
+  TEST_VECTOR(NOK, "\\W+",                      "hej",              0)
+  TEST_VECTOR(OK,  "[0-9]+",                    "12345",            5)
+  TEST_VECTOR(OK,  "\\D",                       "hej",              1)
+  TEST_VECTOR(NOK, "\\d",                       "hej",              0)
+  TEST_VECTOR(OK,  "[^\\w]",                    "\\",               1)
+  TEST_VECTOR(OK,  "[\\W]",                     "\\",               1)
+  TEST_VECTOR(NOK, "[\\w]",                     "\\",               0)
+  TEST_VECTOR(OK,  "[^\\d]",                    "d",                1)
+  TEST_VECTOR(NOK, "[\\d]",                     "d",                0)
+  TEST_VECTOR(NOK, "[^\\D]",                    "d",                0)
+  TEST_VECTOR(OK,  "[\\D]",                     "d",                1)
+  TEST_VECTOR(OK,  "^.*\\\\.*$",                "c:\\Tools",        8)
+  TEST_VECTOR(OK,  "^.*\\\\.*$",                "c:\\Tools",        8)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "%JxLLcVx8wxrjsj",  15)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "=KbvUQjsj",        9)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "^uDnoZjsj",        9)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "UzZbjsj",          7)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "\"wjsj",           5)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "zLa_FTEjsj",       10)
+  TEST_VECTOR(OK,  ".?\\w+jsj$",                "\"mw3p8_Ojsj",     11)
+  TEST_VECTOR(OK,  "^[\\+-]*[\\d]+$",           "+27",              3)
+  TEST_VECTOR(OK,  "[abc]",                     "1c2",              1)
+  TEST_VECTOR(NOK, "[abc]",                     "1C2",              0)
+  TEST_VECTOR(OK,  "[1-5]+",                    "0123456789",       5)
+  TEST_VECTOR(OK,  "[.2]",                      "1C2",              1)
+  TEST_VECTOR(OK,  "a*$",                       "Xaa",              2)
+  TEST_VECTOR(OK,  "a*$",                       "Xaa",              2)
+  TEST_VECTOR(OK,  "[a-h]+",                    "abcdefghxxx",      8)
+  TEST_VECTOR(NOK, "[a-h]+",                    "ABCDEFGH",         0)
+  TEST_VECTOR(OK,  "[A-H]+",                    "ABCDEFGH",         8)
+  TEST_VECTOR(NOK, "[A-H]+",                    "abcdefgh",         0)
+  TEST_VECTOR(OK,  "[^\\s]+",                   "abc def",          3)
+  TEST_VECTOR(OK,  "[^fc]+",                    "abc def",          2)
+  TEST_VECTOR(OK,  "[^d\\sf]+",                 "abc def",          3)
+  TEST_VECTOR(OK,  "\n",                        "abc\ndef",         1)
+  TEST_VECTOR(OK,  "b.\\s*\n",                  "aa\r\nbb\r\ncc\r\n\r\n",4)
+  TEST_VECTOR(OK,  ".*c",                       "abcabc",           6)
+  TEST_VECTOR(OK,  ".+c",                       "abcabc",           6)
+  TEST_VECTOR(OK,  "[b-z].*",                   "ab",               1)
+  TEST_VECTOR(OK,  "b[k-z]*",                   "ab",               1)
+  TEST_VECTOR(NOK, "[0-9]",                     "  - ",             0)
+  TEST_VECTOR(OK,  "[^0-9]",                    "  - ",             1)
+  TEST_VECTOR(OK,  "0|",                        "0|",               2)
+  TEST_VECTOR(NOK, "\\d\\d:\\d\\d:\\d\\d",      "0s:00:00",         0)
+  TEST_VECTOR(NOK, "\\d\\d:\\d\\d:\\d\\d",      "000:00",           0)
+  TEST_VECTOR(NOK, "\\d\\d:\\d\\d:\\d\\d",      "00:0000",          0)
+  TEST_VECTOR(NOK, "\\d\\d:\\d\\d:\\d\\d",      "100:0:00",         0)
+  TEST_VECTOR(NOK, "\\d\\d:\\d\\d:\\d\\d",      "00:100:00",        0)
+  TEST_VECTOR(NOK, "\\d\\d:\\d\\d:\\d\\d",      "0:00:100",         0)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "0:0:0",            5)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "0:00:0",           6)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "0:0:00",           5)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "00:0:0",           6)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "00:00:0",          7)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "00:0:00",          6)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "0:00:00",          6)
+  TEST_VECTOR(OK,  "\\d\\d?:\\d\\d?:\\d\\d?",   "00:00:00",         7)
+  TEST_VECTOR(OK,  "[Hh]ello [Ww]orld\\s*[!]?", "Hello world !",    12)
+  TEST_VECTOR(OK,  "[Hh]ello [Ww]orld\\s*[!]?", "hello world !",    12)
+  TEST_VECTOR(OK,  "[Hh]ello [Ww]orld\\s*[!]?", "Hello World !",    12)
+  TEST_VECTOR(OK,  "[Hh]ello [Ww]orld\\s*[!]?", "Hello world!   ",  11)
+  TEST_VECTOR(OK,  "[Hh]ello [Ww]orld\\s*[!]?", "Hello world  !",   13)
+  TEST_VECTOR(OK,  "[Hh]ello [Ww]orld\\s*[!]?", "hello World    !", 15)
+  TEST_VECTOR(NOK, "\\d\\d?:\\d\\d?:\\d\\d?",   "a:0",              0) /* Failing test case reported in https://github.com/kokke/tiny-regex-c/issues/12 */
+/*
+  TEST_VECTOR(OK,  "[^\\w][^-1-4]",     ")T",          2)
+  TEST_VECTOR(OK,  "[^\\w][^-1-4]",     ")^",          2)
+  TEST_VECTOR(OK,  "[^\\w][^-1-4]",     "*)",          2)
+  TEST_VECTOR(OK,  "[^\\w][^-1-4]",     "!.",          2)
+  TEST_VECTOR(OK,  "[^\\w][^-1-4]",     " x",          2)
+  TEST_VECTOR(OK,  "[^\\w][^-1-4]",     "$b",          2)
+*/
+  TEST_VECTOR(OK,  ".?bar",                      "real_bar",        4)
+  TEST_VECTOR(NOK, ".?bar",                      "real_foo",        0)
+  TEST_VECTOR(NOK, "X?Y",                        "Z",               0)
+  TEST_VECTOR(OK, "[a-z]+\nbreak",              "blahblah\nbreak",  14)
+  TEST_VECTOR(OK, "[a-z\\s]+\nbreak",           "bla bla \nbreak",  14)
@@ -0,0 +1,84 @@
+/*
+ * Testing re_match_batch(), built with -DRE_THREADS=1: every result is what
+ * re_matchpn() gives for the text, however many threads share the batch, also
+ * when a few texts take far longer than the rest and have to be stolen.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+#define NTEXTS  200000
+
+static char data[NTEXTS * 8];
+static const char* texts[NTEXTS];
+static int lengths[NTEXTS];
+static int results[2 * NTEXTS];
+
+
+static int check(re_t pattern)
+{
+  int matched = 0;
+  int i;
+
+  for (i = 0; i < NTEXTS; ++i)
+  {
+    int length;
+    int m = re_matchpn(pattern, texts[i], lengths[i], &length);
+
+    assert(results[2 * i] == m);
+    assert((m == -1) || (results[2 * i + 1] == length));
+    matched += (m != -1);
+  }
+  return matched;
+}
+
+
+int main()
+{
+  static char slow[1 << 16];
+  static void* buf[1024];
+  re_t re = re_compile_into("[a-f]+\\d", buf, sizeof(buf));
+  const char* small[] = { "ab1", "zz", "f0" };
+  int threads[] = { 1, 2, 4, 7, 0 };
+  int t;
+  int i;
+
+  /* Short records, some of them matching */
+  for (i = 0; i < NTEXTS; ++i)
+  {
+    char* p = &data[8 * i];
+    int j;
+    lengths[i] = 1 + (i * 7) % 7;
+    for (j = 0; j < lengths[i]; ++j)
+    {
+      p[j] = "abcxyz0123"[(i * 31 + j * 17) % 10];
+    }
+    texts[i] = p;
+  }
+
+  for (t = 0; t < (int) (sizeof(threads) / sizeof(*threads)); ++t)
+  {
+    memset(results, 0, sizeof(results));
+    assert(re_match_batch(re, texts, lengths, NTEXTS, results, threads[t]) == check(re));
+  }
+
+  /* A handful of slow texts at the front: the threads that finish early steal what is left of the others */
+  memset(slow, 'a', sizeof(slow));
+  for (i = 0; i < 16; ++i)
+  {
+    texts[i] = slow;
+    lengths[i] = sizeof(slow);
+  }
+  re = re_compile_into("a*a*a*[bc]", buf, sizeof(buf));
+  re_set_engine(re, RE_ENGINE_PIKEVM);
+  assert(re_match_batch(re, texts, lengths, NTEXTS, results, 4) == check(re));
+
+  /* '\0'-terminated texts, and a batch too small to split */
+  assert(re_match_batch(re_compile("\\d"), small, 0, 3, results, 4) == 2);
+  assert(results[0] == 2 && results[1] == 1 && results[2] == -1 && results[4] == 1);
+  assert(re_match_batch(re_compile("\\d"), small, 0, 0, results, 0) == 0);
+
+  return 0;
+}
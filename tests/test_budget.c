@@ -0,0 +1,96 @@
+/*
+ * Testing re_matchpn_budget(): with a budget large enough it finds what
+ * re_matchpn() finds, with either engine; a pathological pattern runs out of
+ * it or is cancelled, and gives up with RE_BUDGET_EXCEEDED.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+static const char* patterns[] =
+{
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "[^\\d]+\\\\?\\s", "a+b*[ac]*.+.*.[\\.].", "[-1-2]*", "^\\w+",
+  "x?y*z+", "\\d+ms$", "ERROR \\d+", ".*.*=", "a",
+};
+
+static const char* texts[] =
+{
+  "", "a", "abc 12 x3", "  hello world ", "1-2-1-1", "took 25ms", "[ERROR 42] at x=1", "aaab.c.", "xyzz",
+  "\n\n", "ERROR ERROR 7",
+};
+
+
+/* Budget that is just enough for pattern on text: any less and it gives up */
+static unsigned long enough(re_t re, const char* text, int textlength)
+{
+  unsigned long budget = 1;
+  int length;
+
+  while (re_matchpn_budget(re, text, textlength, &length, budget, 0) == RE_BUDGET_EXCEEDED)
+  {
+    budget += 1;
+  }
+  assert((budget == 1) || (re_matchpn_budget(re, text, textlength, &length, budget - 1, 0) == RE_BUDGET_EXCEEDED));
+  return budget;
+}
+
+
+int main()
+{
+  static void* objects[1024];
+  static char slow[4096];
+  int engines[] = { RE_ENGINE_BACKTRACK, RE_ENGINE_PIKEVM };
+  int npatterns = (int) (sizeof(patterns) / sizeof(*patterns));
+  int ntexts = (int) (sizeof(texts) / sizeof(*texts));
+  int cancel = 0;
+  int p;
+  int t;
+  int e;
+  int length;
+  re_t re;
+
+  /* Enough budget, or none at all, finds the same match */
+  for (p = 0; p < npatterns; ++p)
+  {
+    re = re_compile_into(patterns[p], objects, sizeof(objects));
+    for (e = 0; e < 2; ++e)
+    {
+      re_set_engine(re, engines[e]);
+      for (t = 0; t < ntexts; ++t)
+      {
+        const int textlength = (int) strlen(texts[t]);
+        int expectedlength;
+        int expected = re_matchpn(re, texts[t], textlength, &expectedlength);
+        unsigned long budget = enough(re, texts[t], textlength);
+
+        assert(re_matchpn_budget(re, texts[t], textlength, &length, 0, 0) == expected);
+        assert((expected == -1) || (length == expectedlength));
+        assert(re_matchpn_budget(re, texts[t], textlength, &length, budget, &cancel) == expected);
+        assert((expected == -1) || (length == expectedlength));
+        assert(re_matchp_budget(re, texts[t], &length, 2 * budget, 0) == expected);
+      }
+    }
+  }
+
+  /* Runs of '*' that backtrack into each other take far more than a million steps on a few kB */
+  memset(slow, 'a', sizeof(slow) - 1);
+  re = re_compile_into("a*a*a*a*[bc]", objects, sizeof(objects));
+  assert(re_matchpn_budget(re, slow, (int) sizeof(slow) - 1, &length, 1000000, 0) == RE_BUDGET_EXCEEDED);
+  assert(length == 0);
+  assert(re_matchp_budget(re, slow, &length, 1000000, 0) == RE_BUDGET_EXCEEDED);
+
+  /* ... and a set flag cancels them, with or without a budget */
+  cancel = 1;
+  assert(re_matchpn_budget(re, slow, (int) sizeof(slow) - 1, &length, 0, &cancel) == RE_BUDGET_EXCEEDED);
+  assert(re_matchpn_budget(re, slow, (int) sizeof(slow) - 1, &length, 1000000000, &cancel) == RE_BUDGET_EXCEEDED);
+
+  /* The Pike VM on the same text needs a step per thread and char, so it gets through on a few tens of thousands */
+  re_set_engine(re, RE_ENGINE_PIKEVM);
+  cancel = 0;
+  assert(re_matchpn_budget(re, slow, (int) sizeof(slow) - 1, &length, 100000, &cancel) == -1);
+  assert(re_matchpn_budget(re, slow, (int) sizeof(slow) - 1, &length, 1000, &cancel) == RE_BUDGET_EXCEEDED);
+
+  return 0;
+}
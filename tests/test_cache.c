@@ -0,0 +1,96 @@
+/*
+ * Testing the pattern-cache behind re_match(), built with -DRE_CACHE_SIZE=4:
+ * repeated patterns are compiled once, the least recently used one makes room,
+ * and threads matching at the same time get the same results as re_matchp().
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include "re.h"
+
+
+#define NTHREADS  4
+#define NROUNDS   2000
+
+static const char* patterns[] = { "\\d+", "[a-f]+\\s", "x?y*z", "^GET", "\\.log$", "[^\\w]+", "a+b+", "\\s\\w" };
+static const char* texts[] = { "GET /a.log", "ab 12 xyz", "  aabb", "fed x" };
+#define NPATTERNS  ((int) (sizeof(patterns) / sizeof(*patterns)))
+#define NTEXTS     ((int) (sizeof(texts) / sizeof(*texts)))
+
+static int expected[NPATTERNS][NTEXTS][2];
+
+
+static void* worker(void* arg)
+{
+  int seed = (int) (size_t) arg;
+  int i;
+
+  for (i = 0; i < NROUNDS; ++i)
+  {
+    /* Mostly a few hot patterns, now and then one that evicts */
+    int p = ((i % 7) == 0) ? ((i + seed) % NPATTERNS) : ((i + seed) % 3);
+    int t = (i / 3 + seed) % NTEXTS;
+    int length;
+    int m = re_match(patterns[p], texts[t], &length);
+    assert(m == expected[p][t][0]);
+    assert((m == -1) || (length == expected[p][t][1]));
+  }
+  return 0;
+}
+
+
+int main()
+{
+  re_cache_stats_t stats;
+  pthread_t threads[NTHREADS];
+  void* buf[128];
+  int length;
+  int p;
+  int t;
+
+  for (p = 0; p < NPATTERNS; ++p)
+  {
+    re_t re = re_compile_into(patterns[p], buf, sizeof(buf));
+    assert(re != 0);
+    for (t = 0; t < NTEXTS; ++t)
+    {
+      expected[p][t][0] = re_matchp(re, texts[t], &expected[p][t][1]);
+    }
+  }
+
+  /* One miss, then hits */
+  assert(re_match("\\d+", "ab 12", &length) == 3 && length == 2);
+  assert(re_match("\\d+", "ab 12", &length) == 3 && length == 2);
+  assert(re_matchn("\\d+", "ab 12", 4, &length) == 3 && length == 1);
+  re_cache_stats(&stats);
+  assert(stats.misses == 1 && stats.hits == 2 && stats.evictions == 0);
+
+  /* Invalid patterns are remembered as such */
+  assert(re_match("[abc", "abc", &length) == -1 && length == 0);
+  assert(re_match("[abc", "abc", &length) == -1 && length == 0);
+
+  /* Filling up the cache drops the least recently used pattern, not the hot one */
+  assert(re_match("a", "a", &length) == 0);
+  assert(re_match("b", "b", &length) == 0);
+  assert(re_match("\\d+", "1", &length) == 0);
+  assert(re_match("c", "c", &length) == 0);
+  re_cache_stats(&stats);
+  assert(stats.evictions == 1);
+  assert(re_match("\\d+", "1", &length) == 0);
+  re_cache_stats(&stats);
+  assert(stats.evictions == 1 && stats.misses == 5);
+
+  for (t = 0; t < NTHREADS; ++t)
+  {
+    assert(pthread_create(&threads[t], 0, worker, (void*) (size_t) t) == 0);
+  }
+  for (t = 0; t < NTHREADS; ++t)
+  {
+    pthread_join(threads[t], 0);
+  }
+  re_cache_stats(&stats);
+  assert(stats.hits + stats.misses == 10 + NTHREADS * NROUNDS);
+  assert(stats.hits > stats.misses);
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Testing re.hpp: patterns compiled and matched in constant expressions, and
+ * the same matches as re_matchp() on the regex's of test1.c and on random texts.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.hpp"
+
+
+/* Index * 100 + length of the match, worked out by the compiler for the static_asserts below */
+template <size_t N>
+constexpr int match(const re::pattern<N>& pattern, const char* text)
+{
+  int length = 0;
+  int idx = pattern.match(text, &length);
+  return (idx == -1) ? -1 : (idx * 100 + length);
+}
+
+static_assert(match(re::compile("\\d+"), "took 25ms") == 502, "");
+static_assert(match(re::compile("^\\w+\\s"), "hello world") == 6, "");
+static_assert(match(re::compile("[Hh]ello [Ww]orld\\s*[!]?"), "ahem.. 'hello world !' ..") == 812, "");
+static_assert(match(re::compile("a+b*[ac]*.+.*.[\\.]."), "aaab.c.") == 6, "");
+static_assert(match(re::compile("\\d+ms$"), "took 25ms") == 504, "");
+static_assert(match(re::compile("[^\\d]+\\\\?\\s"), "12ab \\ ") == 205, "");
+static_assert(match(re::compile(""), "") == -1, "");
+static_assert(match(re::compile("x?y"), "") == -1, "");
+
+
+/* The hand-picked regex's of test1.c: checked at compile time against what test1.c expects ... */
+#define OK   1
+#define NOK  0
+
+#define TEST_VECTOR(ok, pattern, text, length) \
+  static_assert((ok) ? (match(re::compile(pattern), text) % 100 == (length)) : (match(re::compile(pattern), text) == -1), pattern);
+#include "test1_vectors.h"
+#undef TEST_VECTOR
+
+/* ... and at run-time against re_matchp(), each with a pattern compiled in a constant expression of its own */
+typedef struct
+{
+  const char* pattern;
+  const char* text;
+  int (*match)(const char* text, int* matchlength);
+} vector_t;
+
+#define TEST_VECTOR(ok, pattern, text, length) \
+  { pattern, text, [](const char* t, int* l) { constexpr auto compiled = re::compile(pattern); return compiled.match(t, l); } },
+static const vector_t vectors[] =
+{
+#include "test1_vectors.h"
+};
+#undef TEST_VECTOR
+
+static const char* patterns[] =
+{
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "\\w*\\d?\\w\\?", "[^\\d]+\\\\?\\s", "a+b*[ac]*.+.*.[\\.].",
+  "a?b[ac*]*.?[\\]+[?]?", "[-1-5]+[-1-2]-[-]", "[-1-2]*", "\\s?[a-fKL098]+-?", "[a\\d]?1234", ".*123faerdig",
+  ".?\\w+jsj", "^\\w+\\s", "^[a-c]*$", ".*.*c$", "[^]]x", "ab\\", "",
+};
+
+static const char alphabet[] = "abc1234-. \\?jsx\n";
+
+
+int main()
+{
+  static void* objects[1024];
+  static char text[64];
+  size_t i;
+  int p;
+  int n;
+
+  /* The regex's of test1.c, compiled at compile time, and at run-time with the same code */
+  for (i = 0; i < sizeof(vectors) / sizeof(*vectors); ++i)
+  {
+    re::pattern<64> pattern(vectors[i].pattern);
+    int expectedlength;
+    int expected = re_matchp(re_compile(vectors[i].pattern), vectors[i].text, &expectedlength);
+    int length;
+
+    assert(vectors[i].match(vectors[i].text, &length) == expected);
+    assert((expected == -1) || (length == expectedlength));
+    assert(pattern.valid());
+    assert(pattern.match(vectors[i].text, &length) == expected);
+    assert((expected == -1) || (length == expectedlength));
+  }
+
+  /* ... and patterns that backtrack, on random texts */
+  srand(1);
+  for (p = 0; p < (int) (sizeof(patterns) / sizeof(*patterns)); ++p)
+  {
+    re::pattern<64> pattern(patterns[p]);
+    re_t re = re_compile_into(patterns[p], objects, sizeof(objects));
+
+    for (n = 0; n < 2000; ++n)
+    {
+      const int textlength = rand() % (int) (sizeof(text) - 1);
+      int expectedlength;
+      int expected;
+      int length;
+
+      for (i = 0; i < (size_t) textlength; ++i)
+      {
+        text[i] = alphabet[rand() % (int) (sizeof(alphabet) - 1)];
+      }
+      text[textlength] = '\0';
+      expected = re_matchp(re, text, &expectedlength);
+      assert(pattern.match(text, &length) == expected);
+      assert((expected == -1) || (length == expectedlength));
+      assert(pattern.matchn(text, textlength / 2, &length) == re_matchpn(re, text, textlength / 2, &expectedlength));
+    }
+  }
+
+  /* Invalid patterns, and ones with more symbols than fit, never match: as a 0 from re_compile() */
+  assert(re::pattern<4>("x*y").valid() && !re::pattern<3>("x*y").valid());
+  {
+    const char* invalid[] = { "[", "[^", "[abc", "[a\\", "\\d[" };
+    int length;
+
+    for (i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i)
+    {
+      re::pattern<16> pattern(invalid[i]);
+
+      assert(re_compile(invalid[i]) == 0);
+      assert(!pattern.valid());
+      assert(pattern.match("[abc", &length) == -1);
+    }
+  }
+
+  return 0;
+}
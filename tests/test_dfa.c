@@ -0,0 +1,131 @@
+/*
+ * Testing the lazy DFA: re_dfa_matchn() finds the same match as the backtracker
+ * on hand-picked texts and on random ones, whether its cache holds every state,
+ * has to be flushed now and then, or is so small that it stops caching halfway
+ * through a text.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+
+static const char* vectors[][2] =
+{
+  { "\\d",                       "5"                },
+  { "\\w+",                      "hej"              },
+  { "[\\S]",                     "\t \n"            },
+  { "[^\\w]",                    "\\"               },
+  { "^.*\\\\.*$",                "c:\\Tools"        },
+  { ".?\\w+jsj$",                "%JxLLcVx8wxrjsj"  },
+  { ".?\\w+jsj$",                "\"mw3p8_Ojsj"     },
+  { "^[\\+-]*[\\d]+$",           "+27"              },
+  { "[1-5]+",                    "0123456789"       },
+  { "a*$",                       "Xaa"              },
+  { "[^d\\sf]+",                 "abc def"          },
+  { "b.\\s*\n",                  "aa\r\nbb\r\ncc\r\n\r\n" },
+  { ".*c",                       "abcabc"           },
+  { "[b-z].*",                   "ab"               },
+  { "\\d\\d:\\d\\d:\\d\\d",      "00:100:00"        },
+  { "\\d\\d?:\\d\\d?:\\d\\d?",   "00:0:00"          },
+  { "[Hh]ello [Ww]orld\\s*[!]?", "hello World    !" },
+  { "\\d\\d?:\\d\\d?:\\d\\d?",   "a:0"              },
+  { ".?bar",                     "real_bar"         },
+  { "X?Y",                       "Z"                },
+  { "[a-z\\s]+\nbreak",          "bla bla \nbreak"  },
+  { "x*",                        ""                 },
+  { "^$",                        ""                 },
+};
+
+static const char* patterns[] =
+{
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "\\w*\\d?\\w\\?", "[^\\d]+\\\\?\\s", "a+b*[ac]*.+.*.[\\.].",
+  "a?b[ac*]*.?[\\]+[?]?", "[-1-5]+[-1-2]-[-]", "\\s?[a-fKL098]+-?", ".*123faerdig", ".?\\w+jsj",
+  "^\\w+\\s", "^[a-c]*$", ".*.*c$", "x?y*z+", "a*a*a*[bc]", "",
+};
+
+static const char alphabet[] = "abc1234-. \\?jsxyz\n";
+
+/* Caches with room for all states, for some of them, and for next to none */
+static const size_t cachesizes[] = { 1 << 16, 2048, 768 };
+
+
+static void check(re_t pattern, re_dfa_t dfa, const char* text, int textlength)
+{
+  int expectedlength;
+  int length;
+  int expected = re_matchpn(pattern, text, textlength, &expectedlength);
+
+  assert(re_dfa_matchn(dfa, text, textlength, &length) == expected);
+  assert((expected == -1) || (length == expectedlength));
+}
+
+
+int main()
+{
+  static void* objects[1024];
+  static void* cache[(1 << 16) / sizeof(void*)];
+  static char text[64];
+  static char longtext[1 << 16];
+  size_t c;
+  int i;
+  int n;
+
+  for (c = 0; c < sizeof(cachesizes) / sizeof(*cachesizes); ++c)
+  {
+    for (i = 0; i < (int) (sizeof(vectors) / sizeof(*vectors)); ++i)
+    {
+      re_t pattern = re_compile_into(vectors[i][0], objects, sizeof(objects));
+      re_dfa_t dfa = re_dfa_init(pattern, cache, cachesizes[c]);
+
+      assert(dfa != 0);
+      check(pattern, dfa, vectors[i][1], (int) strlen(vectors[i][1]));
+    }
+
+    srand(1);
+    for (i = 0; i < (int) (sizeof(patterns) / sizeof(*patterns)); ++i)
+    {
+      re_t pattern = re_compile_into(patterns[i], objects, sizeof(objects));
+      re_dfa_t dfa = re_dfa_init(pattern, cache, cachesizes[c]);
+
+      assert(dfa != 0);
+      for (n = 0; n < 5000; ++n)
+      {
+        const int textlength = rand() % (int) (sizeof(text) - 1);
+        int j;
+
+        for (j = 0; j < textlength; ++j)
+        {
+          text[j] = alphabet[rand() % (int) (sizeof(alphabet) - 1)];
+        }
+        check(pattern, dfa, text, textlength);
+      }
+    }
+  }
+
+  /* A pattern with over a thousand states, on a long text: flushed over and over, or
+     not cached any further from some point on, it still finds the match at the end */
+  for (i = 0; i < (int) sizeof(longtext); ++i)
+  {
+    longtext[i] = (char) ('a' + rand() % 10);
+  }
+  memcpy(longtext + sizeof(longtext) - 13, "aaaaaaaaafadk", 13);
+  for (c = 0; c < sizeof(cachesizes) / sizeof(*cachesizes); ++c)
+  {
+    re_t pattern = re_compile_into("[a-e]........[f-j][a-c][d-j][k-z]", objects, sizeof(objects));
+    re_dfa_t dfa = re_dfa_init(pattern, cache, cachesizes[c]);
+
+    assert(dfa != 0);
+    for (n = 0; n < 3; ++n)
+    {
+      check(pattern, dfa, longtext, (int) sizeof(longtext));
+      check(pattern, dfa, longtext, (int) sizeof(longtext) - 1);
+    }
+  }
+
+  /* A buffer without room for two states is turned down */
+  assert(re_dfa_init(re_compile("a"), cache, 8) == 0);
+
+  return 0;
+}
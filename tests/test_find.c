@@ -0,0 +1,96 @@
+/*
+ * Testing re_find_next(): iterating over every match of a pattern in a buffer,
+ * including empty matches, anchored patterns and '\0'-bytes in the text.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+/* Collect the matches as start, length pairs; returns how many there are */
+static int findall(const char* pattern, const char* text, int textlength, int* found)
+{
+  static void* buf[1024];
+  re_t re = re_compile_into(pattern, buf, sizeof(buf));
+  int cursor = 0;
+  int n = 0;
+  int start;
+  int length;
+
+  while (re_find_next(re, text, textlength, &cursor, &start, &length))
+  {
+    found[2 * n] = start;
+    found[2 * n + 1] = length;
+    n += 1;
+  }
+  /* Once done, it stays done */
+  assert(re_find_next(re, text, textlength, &cursor, &start, &length) == 0);
+  return n;
+}
+
+
+int main()
+{
+  static char big[100000];
+  re_t re = re_compile("w+");
+  int found[64];
+  int cursor = 0;
+  int start;
+  int length;
+  int i;
+
+  assert(findall("\\d+", "a1b22c333", 9, found) == 3);
+  assert(found[0] == 1 && found[1] == 1 && found[2] == 3 && found[3] == 2 && found[4] == 6 && found[5] == 3);
+
+  /* Empty matches move the cursor a byte on; none starts at the end of the text */
+  assert(findall("x*", "axxb", 4, found) == 3);
+  assert(found[0] == 0 && found[1] == 0 && found[2] == 1 && found[3] == 2 && found[4] == 3 && found[5] == 0);
+
+  /* '^' matches at the start of the text only, even when empty */
+  assert(findall("^\\w", "ab", 2, found) == 1 && found[0] == 0);
+  assert(findall("^", "", 0, found) == 1 && found[0] == 0 && found[1] == 0);
+  assert(findall("\\w", "", 0, found) == 0);
+
+  /* '$' at the end of the text, '\0'-bytes are chars like any other */
+  assert(findall("b\\.log$", "ab.log\0b.log", 12, found) == 1 && found[0] == 7 && found[1] == 5);
+  assert(findall("[^a]", "a\0a\0", 4, found) == 2 && found[0] == 1 && found[2] == 3);
+
+  /* Thousands of matches in one buffer */
+  for (i = 0; i < (int) sizeof(big); ++i)
+  {
+    big[i] = (i % 10 == 9) ? ' ' : 'w';
+  }
+  for (i = 0; re_find_next(re, big, (int) sizeof(big), &cursor, &start, &length); ++i)
+  {
+    assert(start == 10 * i && length == 9);
+  }
+  assert(i == 10000);
+
+  /* re_find_next_stats() finds the same; built without RE_STATS, it counts nothing */
+  {
+    re_match_stats_t stats;
+    int statscursor = 0;
+
+    memset(&stats, 0, sizeof(stats));
+    cursor = 0;
+    while (re_find_next(re, big, (int) sizeof(big), &cursor, &start, &length))
+    {
+      int statsstart;
+      int statslength;
+
+      assert(re_find_next_stats(re, big, (int) sizeof(big), &statscursor, &statsstart, &statslength, &stats) == 1);
+      assert(statsstart == start && statslength == length && statscursor == cursor);
+    }
+    assert(re_find_next_stats(re, big, (int) sizeof(big), &statscursor, &start, &length, &stats) == 0);
+    assert(stats.starts == 0 && stats.matchones == 0 && stats.scanned == 0);
+  }
+
+  /* A cursor outside of the text finds nothing */
+  cursor = -1;
+  assert(re_find_next(re, big, (int) sizeof(big), &cursor, &start, &length) == 0);
+  cursor = (int) sizeof(big) + 2;
+  assert(re_find_next(re, big, (int) sizeof(big), &cursor, &start, &length) == 0);
+
+  return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Testing re_jit(), built with -DRE_JIT=1: the compiled code finds the same
+ * matches as the interpreter on the hand-picked patterns and random texts,
+ * and leaves matches with a budget to the interpreter.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+
+static const char* patterns[] =
+{
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "\\w*\\d?\\w\\?", "[^\\d]+\\\\?\\s", "[^\\w][^-1-4]", "a+b*[ac]*.+.*.[\\.].",
+  "a?b[ac*]*.?[\\]+[?]?", "[-1-5]+[-1-2]-[-]", "[-1-2]*", "\\s?[a-fKL098]+-?", "[a\\d]?1234", ".*123faerdig",
+  ".?\\w+jsj", "^\\w+\\s", "^[a-c]*", "x?y*z+", "[^]]x", "[^x]+", "[\\x80-\\xff]+", "ab\\", "a**", "$a", "", "^",
+  "[Hh]ello [Ww]orld\\s*[!]?", "ERROR \\d+", "....", "^.?.?$",
+};
+
+static const char alphabet[] = "abc1234-. \\?jsxyz\n\x80\xe9";
+
+
+int main()
+{
+  static void* objects[1024];
+  static void* plain[1024];
+  static char text[64];
+  int npatterns = (int) (sizeof(patterns) / sizeof(*patterns));
+  int p;
+  int i;
+  int n;
+
+  srand(1);
+  for (p = 0; p < npatterns; ++p)
+  {
+    re_t re = re_compile_into(patterns[p], objects, sizeof(objects));
+    re_t interpreted = re_compile_into(patterns[p], plain, sizeof(plain));
+
+#if defined(__x86_64__) && defined(__linux__)
+    assert(re_jit(re) == 1);
+#else
+    re_jit(re);
+#endif
+    for (n = 0; n < 5000; ++n)
+    {
+      const int textlength = rand() % (int) (sizeof(text) - 1);
+      int expectedlength;
+      int expected;
+      int length;
+
+      for (i = 0; i < textlength; ++i)
+      {
+        text[i] = alphabet[rand() % (int) (sizeof(alphabet) - 1)];
+      }
+      text[textlength] = '\0';
+
+      expected = re_matchpn(interpreted, text, textlength, &expectedlength);
+      assert(re_matchpn(re, text, textlength, &length) == expected);
+      assert((expected == -1) || (length == expectedlength));
+      expected = re_matchp(interpreted, text, &expectedlength);
+      assert(re_matchp(re, text, &length) == expected);
+      assert((expected == -1) || (length == expectedlength));
+    }
+    re_jit_free(re);
+    re_jit_free(re);
+  }
+
+  /* A budget still stops the runs of '*' that backtrack into each other */
+  {
+    static char slow[4096];
+    re_t re = re_compile_into("a*a*a*a*[bc]", objects, sizeof(objects));
+    int length;
+
+    memset(slow, 'a', sizeof(slow) - 1);
+    re_jit(re);
+    assert(re_matchpn_budget(re, slow, (int) sizeof(slow) - 1, &length, 1000000, 0) == RE_BUDGET_EXCEEDED);
+    assert(re_matchpn(re, "aaaac", 5, &length) == 0 && length == 5);
+    re_jit_free(re);
+  }
+
+  assert(re_jit(0) == 0);
+  return 0;
+}
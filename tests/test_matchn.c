@@ -0,0 +1,92 @@
+/*
+ * Testing re_matchn() / re_matchpn() on length-delimited text:
+ * slices of a larger buffer without '\0'-terminator, and text with embedded '\0'-bytes.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+int main()
+{
+  const char buf[] = "GET /index.html HTTP/1.1";
+  const char bin[] = { 'a', 'b', '\0', 'c', '1', '2', '\0', 'x' };
+  int length;
+  re_t pattern;
+
+  /* Slices of buf end where textlength says, not at the terminator */
+  assert(re_matchn("\\w+", buf, 3, &length) == 0 && length == 3);
+  assert(re_matchn("html", buf, 10, &length) == -1);
+  assert(re_matchn("html", buf, 15, &length) == 11 && length == 4);
+  assert(re_matchn("index$", buf + 5, 5, &length) == 0 && length == 5);
+  assert(re_matchn("^/\\w+", buf + 4, 4, &length) == 0 && length == 4);
+  assert(re_matchn("a", buf, 0, &length) == -1);
+
+  /* '\0' is an ordinary byte */
+  pattern = re_compile("c\\d+");
+  assert(re_matchpn(pattern, bin, sizeof(bin), &length) == 3 && length == 3);
+  assert(re_matchpn(pattern, bin, 3, &length) == -1);
+  assert(re_matchn("b.c", bin, sizeof(bin), &length) == 1 && length == 3);
+  assert(re_matchn("[^a-z\\d]x$", bin, sizeof(bin), &length) == 6 && length == 2);
+  assert(re_matchn("\\d\\Dx", bin, sizeof(bin), &length) == 5 && length == 3);
+  assert(re_matchn("b[a-z]", bin, sizeof(bin), &length) == -1);
+
+  /* Patterns starting with literal chars only try the places where those chars occur */
+  assert(re_matchn("HTTP", buf, sizeof(buf) - 1, &length) == 16 && length == 4);
+  assert(re_matchn("HTTP", buf, 19, &length) == -1);
+  assert(re_matchn("in+d", buf, sizeof(buf) - 1, &length) == 5 && length == 3);
+  assert(re_matchn("inx?d", buf, sizeof(buf) - 1, &length) == 5 && length == 3);
+  assert(re_matchn("inx*d", buf, sizeof(buf) - 1, &length) == 5 && length == 3);
+  assert(re_matchn("1\\.1$", buf, sizeof(buf) - 1, &length) == 21 && length == 3);
+  assert(re_matchn("2x", bin, sizeof(bin), &length) == -1);
+  assert(re_matchn("12.x", bin, sizeof(bin), &length) == 4 && length == 4);
+
+  /* ... and text without a literal that every match contains is passed over */
+  assert(re_matchn("\\d+-ERR-\\w+", "id 12-ERR-io", 12, &length) == 3 && length == 9);
+  assert(re_matchn("\\d+-ERR-\\w+", "id 12-ERR-", 10, &length) == -1);
+  assert(re_matchn("\\d+-ERR-\\w+", "-ERR-x 1-ER", 11, &length) == -1);
+  assert(re_matchn("\\s+ca+b", "xcab caaab", 10, &length) == 4 && length == 6);
+  assert(re_matchn("\\w+/\\d\\.1", buf, sizeof(buf) - 1, &length) == 16 && length == 8);
+  assert(re_matchn(".*html", buf, sizeof(buf) - 1, &length) == 0 && length == 15);
+
+  /* Start positions are skipped by the bytes a match can start with */
+  assert(re_matchn("[A-Z]+/", buf, sizeof(buf) - 1, &length) == 16 && length == 5);
+  assert(re_matchn("\\d+", buf, sizeof(buf) - 1, &length) == 21 && length == 1);
+  assert(re_matchn("x?\\.\\w", buf, sizeof(buf) - 1, &length) == 9 && length == 3);
+  assert(re_matchn("l*\\s*H", buf, sizeof(buf) - 1, &length) == 14 && length == 3);
+  assert(re_matchn("\\d*$", buf, sizeof(buf) - 1, &length) == 23 && length == 1);
+  assert(re_matchn("\\d*$", buf, 21, &length) == -1);
+  assert(re_matchn("\\d?", buf, sizeof(buf) - 1, &length) == 0 && length == 0);
+
+  /* Patterns ending in '$' are matched backwards from the end of text */
+  assert(re_matchn("\\.log$", "a.log.log", 9, &length) == 5 && length == 4);
+  assert(re_matchn("\\.log$", "a.log.log", 8, &length) == -1);
+  assert(re_matchn("\\w+\\.log$", "x y.log.log", 11, &length) == 4 && length == 7);
+  assert(re_matchn("o?g*$", "a.log", 5, &length) == 3 && length == 2);
+  assert(re_matchn("\\d*$", "a.log", 5, &length) == -1);
+  assert(re_matchn("$", "a.log", 5, &length) == -1);
+
+  /* Long runs of '*' and '+' end exactly at the first char that doesn't match, wherever it is */
+  {
+    char run[100];
+    int i;
+
+    for (i = 0; i < (int) sizeof(run); ++i)
+    {
+      memset(run, '7', sizeof(run));
+      run[i] = 'x';
+      assert(re_matchn("\\d+", run, sizeof(run), &length) == ((i == 0) ? 1 : 0));
+      assert(length == ((i == 0) ? (int) sizeof(run) - 1 : i));
+      assert(re_matchn("[0-9]*x", run, sizeof(run), &length) == 0 && length == i + 1);
+      assert(re_matchn(".+x", run, sizeof(run), &length) == ((i == 0) ? -1 : 0));
+    }
+  }
+
+  /* re_matchp() agrees with re_matchpn() over the whole string */
+  pattern = re_compile("HT+P/\\d\\.\\d$");
+  assert(re_matchp(pattern, buf, &length) == re_matchpn(pattern, buf, (int) strlen(buf), &length));
+  assert(re_matchp(pattern, buf, &length) == 16 && length == 8);
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Testing re_matchpn_memo(): the same match as re_matchpn() on random texts,
+ * with a memo for all of the text, part of it or none, and the pathological
+ * patterns that make the backtracker take exponential time done in a blink.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+
+static const char* patterns[] =
+{
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "\\w*\\d?\\w\\?", "[^\\d]+\\\\?\\s", "a+b*[ac]*.+.*.[\\.].",
+  "a?b[ac*]*.?[\\]+[?]?", "[-1-5]+[-1-2]-[-]", "[-1-2]*", "\\s?[a-fKL098]+-?", "[a\\d]?1234", ".*123faerdig",
+  ".?\\w+jsj", "^\\w+\\s", "^[a-c]*$", "a*a*a*b", ".*.*c$", "[ab]?[ab]?[ab]?b", "x",
+};
+
+static const char alphabet[] = "abc1234-. \\?jsx";
+
+
+int main()
+{
+  static void* objects[1024];
+  static unsigned char memo[1 << 16];
+  static char text[4096];
+  int npatterns = (int) (sizeof(patterns) / sizeof(*patterns));
+  int p;
+  int i;
+  int n;
+
+  srand(1);
+  for (p = 0; p < npatterns; ++p)
+  {
+    re_t re = re_compile_into(patterns[p], objects, sizeof(objects));
+
+    for (n = 0; n < 2000; ++n)
+    {
+      const int textlength = rand() % 40;
+      int expectedlength;
+      int expected;
+      int length;
+
+      for (i = 0; i < textlength; ++i)
+      {
+        text[i] = alphabet[rand() % (int) (sizeof(alphabet) - 1)];
+      }
+      expected = re_matchpn(re, text, textlength, &expectedlength);
+
+      assert(re_memo_size(re, textlength) <= sizeof(memo));
+      assert(re_matchpn_memo(re, text, textlength, &length, memo, re_memo_size(re, textlength)) == expected);
+      assert((expected == -1) || (length == expectedlength));
+      assert(re_matchpn_memo(re, text, textlength, &length, memo, (size_t) (n % 7)) == expected);
+      assert((expected == -1) || (length == expectedlength));
+      assert(re_matchpn_memo(re, text, textlength, &length, 0, 0) == expected);
+      assert((expected == -1) || (length == expectedlength));
+    }
+  }
+
+  /* Runs of '*' that backtrack into each other, O(n^5) without the memo */
+  memset(text, 'a', sizeof(text));
+  for (p = 0; p < 2; ++p)
+  {
+    re_t re = re_compile_into((p == 0) ? "a*a*a*a*[bc]" : "\\w*\\w*\\w*\\W\\d", objects, sizeof(objects));
+    int length;
+
+    text[sizeof(text) - 1] = (p == 0) ? 'a' : '!';
+    assert(re_memo_size(re, (int) sizeof(text)) <= sizeof(memo));
+    assert(re_matchpn_memo(re, text, (int) sizeof(text), &length, memo, sizeof(memo)) == -1);
+  }
+
+  /* An invalid pattern needs no memo and matches nothing */
+  {
+    int length;
+
+    assert(re_memo_size(re_compile("[abc"), 16) == 0);
+    assert(re_matchpn_memo(re_compile("[abc"), "abc", 3, &length, memo, sizeof(memo)) == -1);
+  }
+
+  return 0;
+}
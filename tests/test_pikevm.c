@@ -0,0 +1,98 @@
+/*
+ * Testing the Pike VM engine: it finds the same match as the backtracker, at the
+ * same offset and of the same length, on hand-picked texts and on random ones.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+
+static const char* vectors[][2] =
+{
+  { "\\d",                       "5"                },
+  { "\\w+",                      "hej"              },
+  { "[\\S]",                     "\t \n"            },
+  { "[^\\w]",                    "\\"               },
+  { "^.*\\\\.*$",                "c:\\Tools"        },
+  { ".?\\w+jsj$",                "%JxLLcVx8wxrjsj"  },
+  { ".?\\w+jsj$",                "\"mw3p8_Ojsj"     },
+  { "^[\\+-]*[\\d]+$",           "+27"              },
+  { "[1-5]+",                    "0123456789"       },
+  { "a*$",                       "Xaa"              },
+  { "[^d\\sf]+",                 "abc def"          },
+  { "b.\\s*\n",                  "aa\r\nbb\r\ncc\r\n\r\n" },
+  { ".*c",                       "abcabc"           },
+  { "[b-z].*",                   "ab"               },
+  { "\\d\\d:\\d\\d:\\d\\d",      "00:100:00"        },
+  { "\\d\\d?:\\d\\d?:\\d\\d?",   "00:0:00"          },
+  { "[Hh]ello [Ww]orld\\s*[!]?", "hello World    !" },
+  { "\\d\\d?:\\d\\d?:\\d\\d?",   "a:0"              },
+  { ".?bar",                     "real_bar"         },
+  { "X?Y",                       "Z"                },
+  { "[a-z\\s]+\nbreak",          "bla bla \nbreak"  },
+  { "x*",                        ""                 },
+  { "^$",                        ""                 },
+};
+
+static const char* patterns[] =
+{
+  "\\d+\\w?\\D\\d", "\\s+[a-zA-Z0-9?]*", "\\w*\\d?\\w\\?", "[^\\d]+\\\\?\\s", "a+b*[ac]*.+.*.[\\.].",
+  "a?b[ac*]*.?[\\]+[?]?", "[-1-5]+[-1-2]-[-]", "\\s?[a-fKL098]+-?", ".*123faerdig", ".?\\w+jsj",
+  "^\\w+\\s", "^[a-c]*$", ".*.*c$", "x?y*z+", "a*a*a*[bc]", "",
+};
+
+static const char alphabet[] = "abc1234-. \\?jsxyz\n";
+
+
+static void check(re_t backtrack, re_t pikevm, const char* text, int textlength)
+{
+  int expectedlength;
+  int length;
+  int expected = re_matchpn(backtrack, text, textlength, &expectedlength);
+
+  assert(re_matchpn(pikevm, text, textlength, &length) == expected);
+  assert((expected == -1) || (length == expectedlength));
+}
+
+
+int main()
+{
+  static void* objects[1024];
+  static void* vmobjects[1024];
+  static char text[64];
+  int i;
+  int n;
+
+  for (i = 0; i < (int) (sizeof(vectors) / sizeof(*vectors)); ++i)
+  {
+    re_t backtrack = re_compile_into(vectors[i][0], objects, sizeof(objects));
+    re_t pikevm = re_compile_into(vectors[i][0], vmobjects, sizeof(vmobjects));
+
+    re_set_engine(pikevm, RE_ENGINE_PIKEVM);
+    check(backtrack, pikevm, vectors[i][1], (int) strlen(vectors[i][1]));
+  }
+
+  srand(1);
+  for (i = 0; i < (int) (sizeof(patterns) / sizeof(*patterns)); ++i)
+  {
+    re_t backtrack = re_compile_into(patterns[i], objects, sizeof(objects));
+    re_t pikevm = re_compile_into(patterns[i], vmobjects, sizeof(vmobjects));
+
+    re_set_engine(pikevm, RE_ENGINE_PIKEVM);
+    for (n = 0; n < 5000; ++n)
+    {
+      const int textlength = rand() % (int) (sizeof(text) - 1);
+      int j;
+
+      for (j = 0; j < textlength; ++j)
+      {
+        text[j] = alphabet[rand() % (int) (sizeof(alphabet) - 1)];
+      }
+      check(backtrack, pikevm, text, textlength);
+    }
+  }
+
+  return 0;
+}
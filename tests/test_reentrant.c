@@ -0,0 +1,78 @@
+/*
+ * Testing re_compile_into() / re_compiled_size(): several patterns compiled into
+ * caller-owned buffers must be usable side by side, independent of re_compile().
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "re.h"
+
+
+int main()
+{
+  void* buf[64];  /* void*-array to get pointer alignment */
+  void* buf2[64];
+  size_t size;
+  re_t digits;
+  re_t words;
+  int length;
+
+  /* Invalid patterns have no size */
+  assert(re_compiled_size("\\\x01[^\\\xff][^") == 0);
+  assert(re_compiled_size("[abc") == 0);
+
+  /* Buffer must hold at least re_compiled_size() bytes */
+  size = re_compiled_size("[0-9]+");
+  assert(size > 0 && size <= sizeof(buf));
+  assert(re_compile_into("[0-9]+", buf, size - 1) == NULL);
+  assert(re_compile_into("[0-9]+", NULL, size) == NULL);
+
+  digits = re_compile_into("[0-9]+", buf, size);
+  words = re_compile_into("[a-z]+", buf2, sizeof(buf2));
+  assert(digits != NULL && words != NULL);
+
+  /* The static buffer of re_compile() does not disturb either of them */
+  assert(re_compile("x") != NULL);
+  assert(re_matchp(digits, "abc 123", &length) == 4 && length == 3);
+  assert(re_matchp(words, "123 abc", &length) == 4 && length == 3);
+
+  /* Patterns longer than the static buffer allows compile fine into a large enough buffer */
+  {
+    const char* pattern = "a1a2a3a4a5a6a7a8a9b1b2b3b4b5b6b7b8b9c1c2c3c4c5c6c7c8c9[x]";
+    void* big = malloc(re_compiled_size(pattern));
+    re_t re = re_compile_into(pattern, big, re_compiled_size(pattern));
+    assert(re != NULL);
+    assert(re_compile(pattern) == NULL);
+    assert(re_matchp(re, "--a1a2a3a4a5a6a7a8a9b1b2b3b4b5b6b7b8b9c1c2c3c4c5c6c7c8c9x", &length) == 2);
+    assert(length == 55);
+    free(big);
+  }
+
+  /* ... up to RE_MAX_SYMBOLS of them, which bounds the stack the matchers take */
+  {
+    static char pattern[2000000 + 1];
+    static char text[RE_MAX_SYMBOLS + 3];
+    void* big;
+    re_t re;
+
+    memset(pattern, 'a', sizeof(pattern) - 1);
+    assert(re_compiled_size(pattern) == 0);
+    pattern[RE_MAX_SYMBOLS + 1] = '\0';
+    assert(re_compiled_size(pattern) == 0);
+    pattern[RE_MAX_SYMBOLS] = '\0';
+    big = malloc(re_compiled_size(pattern));
+    re = re_compile_into(pattern, big, re_compiled_size(pattern));
+    assert(re != NULL);
+
+    memset(text, 'a', sizeof(text) - 1);
+    text[0] = '-';
+    re_set_engine(re, RE_ENGINE_PIKEVM);
+    assert(re_matchp(re, text, &length) == 1 && length == RE_MAX_SYMBOLS);
+    re_set_engine(re, RE_ENGINE_BACKTRACK);
+    assert(re_matchp(re, text, &length) == 1 && length == RE_MAX_SYMBOLS);
+    free(big);
+  }
+
+  return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * Testing re_scan_parallel(), built with -DRE_THREADS=1: the lines reported are
+ * those re_matchpn() matches, in order, however many threads scan the buffer.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "re.h"
+
+
+#define BUFSIZE  (3 << 20)
+
+static char buf[BUFSIZE];
+static size_t expected[4][200000];
+static size_t nexpected;
+static size_t nreported;
+
+
+static void record(void* context, size_t linestart, size_t linelength, size_t matchstart, size_t matchlength)
+{
+  (void) context;
+  assert(nreported < nexpected);
+  assert(expected[0][nreported] == linestart && expected[1][nreported] == linelength);
+  assert(expected[2][nreported] == matchstart && expected[3][nreported] == matchlength);
+  nreported += 1;
+}
+
+/* Match the lines one by one, then compare with a scan by nthreads threads */
+static void check(re_t pattern, size_t len, int nthreads)
+{
+  size_t pos = 0;
+
+  nexpected = 0;
+  while (pos < len)
+  {
+    const char* newline = (const char*) memchr(buf + pos, '\n', len - pos);
+    size_t linelength = (newline == 0) ? (len - pos) : (size_t) (newline - (buf + pos));
+    int length;
+    int m = re_matchpn(pattern, buf + pos, (int) linelength, &length);
+
+    if (m != -1)
+    {
+      expected[0][nexpected] = pos;
+      expected[1][nexpected] = linelength;
+      expected[2][nexpected] = pos + (size_t) m;
+      expected[3][nexpected] = (size_t) length;
+      nexpected += 1;
+    }
+    pos += linelength + 1;
+  }
+
+  nreported = 0;
+  assert(re_scan_parallel(pattern, buf, len, nthreads, record, 0) == nexpected);
+  assert(nreported == nexpected);
+}
+
+
+int main()
+{
+  static void* objects[1024];
+  const char* patterns[] = { "ERROR \\d+", "\\d\\d$", "^$", "x", "\\w+" };
+  int threads[] = { 1, 3, 8, 0 };
+  size_t pos = 0;
+  int line = 0;
+  int p;
+  int t;
+
+  /* Log lines of varying length, now and then an empty one or an error */
+  while (pos < BUFSIZE - 100)
+  {
+    if (line % 11 == 0)
+    {
+      buf[pos++] = '\n';
+    }
+    else if (line % 7 == 0)
+    {
+      pos += (size_t) sprintf(buf + pos, "%d ERROR %d in module %d\n", line, line % 1000, line % 13);
+    }
+    else
+    {
+      pos += (size_t) sprintf(buf + pos, "%d INFO request served in %dms\n", line, line % 97);
+    }
+    line += 1;
+  }
+
+  for (p = 0; p < (int) (sizeof(patterns) / sizeof(*patterns)); ++p)
+  {
+    re_t re = re_compile_into(patterns[p], objects, sizeof(objects));
+    for (t = 0; t < (int) (sizeof(threads) / sizeof(*threads)); ++t)
+    {
+      check(re, pos, threads[t]);
+    }
+    /* Without the last newline, cut into the middle of a line, and nothing at all */
+    check(re, pos - 1, 4);
+    check(re, pos / 2, 4);
+    check(re, 0, 4);
+  }
+
+  return 0;
+}
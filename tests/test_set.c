@@ -0,0 +1,92 @@
+/*
+ * Testing pattern sets: re_set_matchn() reports exactly the patterns for which
+ * re_matchpn() finds a match, also when the state-cache is as small as allowed,
+ * and when the patterns are (partly) plain strings found by Aho-Corasick.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+static const char* keywords[] = { "he", "she", "his", "hers", "\\.log", "s", "he", "x+", "sh\\\\e" };
+static const char* keytexts[] = { "ushers", "this", "a.log", "xsh\\e", "hhhe", "" };
+static const char* patterns[] = { "\\d+", "^GET", "\\.log$", "ERR\\w*", "[a-f]+\\s", "x?y*", "^$", "a.c", "[^\\s]+$", "\\s\\s" };
+static const char* texts[] = { "", "GET /a.log", "ERROR 42", "  abc  ", "fed x", "xyz", "no match here\n", "GET", "a\nc" };
+#define NPATTERNS  ((int) (sizeof(patterns) / sizeof(*patterns)))
+#define NTEXTS     ((int) (sizeof(texts) / sizeof(*texts)))
+
+
+static void check(re_set_t set, const char** patternlist, int npatterns, const char** textlist, int ntexts)
+{
+  void* buf[128];
+  int ids[16];
+  int t;
+  int p;
+
+  for (t = 0; t < ntexts; ++t)
+  {
+    int length = (int) strlen(textlist[t]);
+    int n = re_set_matchn(set, textlist[t], length, ids);
+    int k = 0;
+    for (p = 0; p < npatterns; ++p)
+    {
+      int matchlength;
+      re_t re = re_compile_into(patternlist[p], buf, sizeof(buf));
+      if (re_matchpn(re, textlist[t], length, &matchlength) != -1)
+      {
+        assert(k < n && ids[k] == p);
+        ++k;
+      }
+    }
+    assert(k == n);
+  }
+}
+
+
+int main()
+{
+  static void* big[8192];
+  static void* small[8192];
+  const char* invalid[] = { "abc", "[abc" };
+  int ids[NPATTERNS];
+  size_t size = re_set_size(patterns, NPATTERNS);
+  re_set_t set;
+
+  assert(size > 0 && size < sizeof(small));
+
+  /* Invalid patterns and short buffers are refused */
+  assert(re_set_size(invalid, 2) == 0);
+  assert(re_set_compile(invalid, 2, big, sizeof(big)) == 0);
+  assert(re_set_compile(patterns, NPATTERNS, small, size - 1) == 0);
+
+  /* An empty set matches nothing */
+  set = re_set_compile(patterns, 0, big, sizeof(big));
+  assert(set != 0 && re_set_match(set, "abc", ids) == 0);
+
+  set = re_set_compile(patterns, NPATTERNS, big, sizeof(big));
+  assert(set != 0);
+  assert(re_set_match(set, "GET 12", ids) == 4 && ids[0] == 0 && ids[1] == 1 && ids[2] == 5 && ids[3] == 8);
+  check(set, patterns, NPATTERNS, texts, NTEXTS);
+  check(set, patterns, NPATTERNS, texts, NTEXTS);
+
+  /* Room for no more than a couple of states: flushed over and over, same results */
+  set = re_set_compile(patterns, NPATTERNS, small, size);
+  assert(set != 0);
+  check(set, patterns, NPATTERNS, texts, NTEXTS);
+
+  /* Overlapping and repeated strings, escaped metachars, next to a pattern that is no plain string */
+  set = re_set_compile(keywords, 9, big, sizeof(big));
+  assert(set != 0);
+  assert(re_set_match(set, "ushers", ids) == 5 && ids[0] == 0 && ids[1] == 1 && ids[2] == 3 && ids[3] == 5 && ids[4] == 6);
+  check(set, keywords, 9, keytexts, 6);
+  set = re_set_compile(keywords, 9, small, re_set_size(keywords, 9));
+  check(set, keywords, 9, keytexts, 6);
+  check(set, keywords, 9, texts, NTEXTS);
+
+  /* The length bounds the text, '\0'-bytes included */
+  set = re_set_compile(patterns, NPATTERNS, big, sizeof(big));
+  assert(re_set_matchn(set, "ab\0c.log", 8, ids) == 3 && ids[0] == 2 && ids[1] == 5 && ids[2] == 8);
+
+  return 0;
+}
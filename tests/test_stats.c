@@ -0,0 +1,116 @@
+/*
+ * Testing re_matchpn_stats(), built with -DRE_STATS=1: the counts of places
+ * tried, matchpattern() calls, chars tested, backtracking and nesting, worked
+ * out by hand for a few patterns, and the same matches as re_matchpn(). A pass
+ * of re_find_next_stats() over all matches in a text scans each byte about
+ * once per prefilter, and examines no more per byte as the text grows.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+static re_match_stats_t stats;
+
+/* Texts of 700, 1400 and 2800 lines */
+static const char line[] = "took 25ms, ERR7 or 3 x";
+static char text[2800 * (sizeof(line) - 1)];
+
+static int match(const char* pattern, const char* text, int engine)
+{
+  static void* objects[1024];
+  re_t re = re_compile_into(pattern, objects, sizeof(objects));
+  const int textlength = (int) strlen(text);
+  int expectedlength;
+  int expected;
+  int length;
+  int m;
+
+  re_set_engine(re, engine);
+  expected = re_matchpn(re, text, textlength, &expectedlength);
+  m = re_matchpn_stats(re, text, textlength, &length, &stats);
+  assert(m == expected);
+  assert((m == -1) || (length == expectedlength));
+  return m;
+}
+
+
+/* Find all matches in the first textlength bytes of text; returns the bytes examined, by prefilters and matchers */
+static unsigned long findall(const char* pattern, int textlength, int engine, int* n)
+{
+  static void* objects[1024];
+  re_t re = re_compile_into(pattern, objects, sizeof(objects));
+  int cursor = 0;
+  int start;
+  int length;
+
+  re_set_engine(re, engine);
+  memset(&stats, 0, sizeof(stats));
+  *n = 0;
+  while (re_find_next_stats(re, text, textlength, &cursor, &start, &length, &stats))
+  {
+    *n += 1;
+  }
+  /* The required literal and a place to start are each looked for once per byte, give or take a literal */
+  assert(stats.scanned <= 2 * (unsigned long) textlength + 8);
+  return stats.scanned + stats.matchones;
+}
+
+static void checklinear(const char* pattern, int engine)
+{
+  int n1;
+  int n2;
+  int n4;
+  unsigned long examined1 = findall(pattern, (int) sizeof(text) / 4, engine, &n1);
+  unsigned long examined2 = findall(pattern, (int) sizeof(text) / 2, engine, &n2);
+  unsigned long examined4 = findall(pattern, (int) sizeof(text), engine, &n4);
+
+  /* Twice the lines on top cost no more than twice what the lines on top did before */
+  assert((n1 == 700) && (n2 == 1400) && (n4 == 2800));
+  assert(examined4 - examined2 <= 2 * (examined2 - examined1));
+}
+
+
+int main()
+{
+  int i;
+
+  /* The prefix is looked up with memchr(), and matched at one place without a quantifier */
+  assert(match("abc", "xxabc", RE_ENGINE_BACKTRACK) == 2);
+  assert(stats.starts == 1 && stats.matchpatterns == 1 && stats.matchones == 3);
+  assert(stats.backtracks == 0 && stats.maxdepth == 1);
+
+  /* Each of the 6 places runs \w* to the end and backs off all the way: 21 places backed off to,
+     21 chars in the runs and 21 tested against \d, 6 + 27 calls of matchpattern() */
+  assert(match("\\w*\\d", "abcdef", RE_ENGINE_BACKTRACK) == -1);
+  assert(stats.starts == 6 && stats.matchpatterns == 33 && stats.matchones == 42);
+  assert(stats.backtracks == 21 && stats.maxdepth == 2);
+
+  /* '?' nests a call of matchpattern() for each one */
+  assert(match("a?b?c", "abc", RE_ENGINE_BACKTRACK) == 0);
+  assert(stats.starts == 1 && stats.maxdepth == 3 && stats.backtracks == 0);
+
+  /* The Pike VM starts a thread at each place and never backtracks */
+  assert(match("\\w*\\d", "abcdef", RE_ENGINE_PIKEVM) == -1);
+  assert(stats.starts == 6 && stats.matchpatterns == 0 && stats.backtracks == 0 && stats.maxdepth == 0);
+  assert(stats.matchones == 12);
+
+  /* Text without the required literal isn't matched at all */
+  assert(match("^\\w+x", "aaaa", RE_ENGINE_BACKTRACK) == -1);
+  assert(stats.starts == 0 && stats.matchpatterns == 0 && stats.matchones == 0);
+
+  /* Thousands of matches, and text between them that the prefilters skip: a prefix, a required literal
+     behind a class of first bytes, and both with the Pike VM */
+  for (i = 0; i < (int) sizeof(text); ++i)
+  {
+    text[i] = line[i % (int) (sizeof(line) - 1)];
+  }
+  checklinear("ERR\\d", RE_ENGINE_BACKTRACK);
+  checklinear("\\d+ms", RE_ENGINE_BACKTRACK);
+  checklinear("\\w+ms", RE_ENGINE_BACKTRACK);
+  checklinear("ERR\\d", RE_ENGINE_PIKEVM);
+  checklinear("\\d+ms", RE_ENGINE_PIKEVM);
+
+  return 0;
+}
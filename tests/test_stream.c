@@ -0,0 +1,129 @@
+/*
+ * Testing streams: the matches reported for text fed in pieces, down to a byte
+ * at a time, are those found by calling re_matchpn() after each match in turn.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "re.h"
+
+
+static size_t found[64][2];
+static int nfound;
+
+static void record(void* context, size_t matchstart, size_t matchlength)
+{
+  (void) context;
+  assert(nfound < 64);
+  found[nfound][0] = matchstart;
+  found[nfound][1] = matchlength;
+  nfound += 1;
+}
+
+/* Feed text in pieces of step bytes; returns the number of matches, -1 on overflow */
+static int feed(const char* pattern, const char* text, int step, size_t lookbehind)
+{
+  static void* buf[1024];
+  static void* streambuf[1024];
+  re_t re = re_compile_into(pattern, buf, sizeof(buf));
+  re_stream_t stream;
+  int length = (int) strlen(text);
+  int pos;
+  int n = 0;
+  int r;
+
+  assert(re_stream_size(re, lookbehind) <= sizeof(streambuf));
+  stream = re_stream_init(re, streambuf, re_stream_size(re, lookbehind), record, 0);
+  assert(stream != 0);
+  nfound = 0;
+  for (pos = 0; pos < length; pos += step)
+  {
+    r = re_stream_feed(stream, text + pos, (length - pos < step) ? (length - pos) : step);
+    if (r == -1)
+    {
+      return -1;
+    }
+    n += r;
+  }
+  r = re_stream_finish(stream);
+  if (r == -1)
+  {
+    return -1;
+  }
+  assert(n + r == nfound);
+  return nfound;
+}
+
+/* Compare with re_matchpn() on what is left of the text after each match */
+static void check(const char* pattern, const char* text)
+{
+  static void* buf[1024];
+  re_t re = re_compile_into(pattern, buf, sizeof(buf));
+  int length = (int) strlen(text);
+  int step;
+
+  for (step = 1; step <= length + 1; ++step)
+  {
+    int offset = 0;
+    int k = 0;
+
+    assert(feed(pattern, text, step, 256) >= 0);
+    for (;;)
+    {
+      int matchlength;
+      int m = re_matchpn(re, text + offset, length - offset, &matchlength);
+
+      if (m == -1)
+      {
+        break;
+      }
+      assert(k < nfound);
+      assert(found[k][0] == (size_t) (offset + m) && found[k][1] == (size_t) matchlength);
+      ++k;
+      if (pattern[0] == '^')
+      {
+        break;
+      }
+      offset += m + matchlength + (matchlength == 0);
+    }
+    assert(k == nfound);
+  }
+}
+
+
+int main()
+{
+  static void* buf[1024];
+
+  /* Matches across piece boundaries, at absolute offsets */
+  assert(feed("ERROR \\d+", "ok ERROR 12 ok ERROR 345", 1, 2) == 2);
+  assert(found[0][0] == 3 && found[0][1] == 8 && found[1][0] == 15 && found[1][1] == 9);
+  assert(feed("ERROR \\d+", "ok ERROR 12 ok ERROR 345", 5, 2) == 2);
+  assert(found[1][0] == 15 && found[1][1] == 9);
+
+  check("\\d+", "a1b22c333");
+  check("ab*c", "xabbbcabcac");
+  check("x*", "axxb");
+  check("a?b", "aabab b");
+  check("^\\w+", "abc def");
+  check("^$", "");
+  check("\\.log$", "a.log.log");
+  check("[^a]+$", "aab ba");
+  check("a.*b", "a b a b c");
+  check("\\s", " a\tb\n");
+
+  /* A greedy match has to see the whole rest of the stream before it knows where it ends */
+  assert(feed("a.*b", "a b cccccccccccccc", 1, 4) == -1);
+  assert(feed("a.*b", "a b cccccccccccccc", 1, 32) == 1 && found[0][0] == 0 && found[0][1] == 3);
+  assert(feed("\\d+", "1 22 333 4444 55555", 1, 2) == 5);
+  assert(feed("\\d+", "1 22 333 4444 55555", 1, 1) == -1);
+
+  /* Too small a buffer is refused */
+  assert(re_stream_init(re_compile_into("abc", buf, sizeof(buf)), buf + 512, 16, record, 0) == 0);
+
+  /* ... and so is an invalid pattern, which has no size */
+  assert(re_stream_size(re_compile("[abc"), 16) == 0);
+  assert(re_stream_init(re_compile("[abc"), buf + 512, 1024, record, 0) == 0);
+
+  return 0;
+}
@@ -0,0 +1,720 @@
+/*
+ * tregrep: search files and directory trees for lines matching a pattern, like grep -r.
+ *
+ *   tregrep [-c] [-l] [-o] [-n] [-j threads] pattern [path ...]
+ *
+ *   -c  print the number of matching lines of each file
+ *   -l  print only the names of files with a match
+ *   -o  print only the matches, each on a line of its own
+ *   -n  put the line number in front of each line
+ *   -j  number of threads (one per CPU by default)
+ *
+ * Directories are searched recursively, "." if no path is given. Files are mapped into memory and
+ * searched by a pool of threads: each has a deque of tasks (a directory to read, a file, or a piece of
+ * a large file) that it pushes to and pops from at the back, and when it runs dry it steals from the
+ * front of another's. A file's lines are printed together and in order, once all its pieces are done.
+ * Exits with 0 if a line matched, 1 if none did and 2 on an error.
+ */
+
+#define _POSIX_C_SOURCE 200112L  /* sysconf(), lstat() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "re.h"
+
+
+#define MAX_THREADS  256
+#define PIECE_SIZE   (4 << 20)  /* files larger than this are cut into pieces of whole lines of about this size */
+
+enum { TASK_DIR, TASK_FILE, TASK_PIECE };
+
+/* A match to print: the line it is on, the match in it and the line's number, counted from the start of its piece */
+typedef struct
+{
+  size_t  linestart;
+  size_t  linelength;
+  size_t  matchstart;
+  size_t  matchlength;
+  size_t  line;
+} hit_t;
+
+typedef struct
+{
+  size_t  start;
+  size_t  end;
+  size_t  matched;    /* lines that matched   */
+  size_t  nlines;     /* newlines in the piece */
+  hit_t*  hits;
+  size_t  nhits;
+  size_t  capacity;
+} piece_t;
+
+typedef struct
+{
+  char*     path;
+  char*     map;
+  size_t    size;
+  size_t    npieces;
+  size_t    remaining;  /* pieces still being searched */
+  piece_t*  pieces;
+} file_t;
+
+typedef struct
+{
+  int      type;
+  char*    path;   /* TASK_DIR and TASK_FILE */
+  file_t*  file;   /* TASK_PIECE             */
+  size_t   piece;
+} task_t;
+
+/* Deque of tasks in a ring: the owner pushes and pops at the back, thieves take from the front */
+typedef struct
+{
+  pthread_mutex_t  lock;
+  task_t*          tasks;
+  size_t           head;
+  size_t           count;
+  size_t           capacity;
+} deque_t;
+
+
+static re_t pattern;
+static int countonly;
+static int namesonly;
+static int matchesonly;
+static int numbered;
+static int prefixed;
+static int nthreads;
+
+static deque_t deques[MAX_THREADS];
+static size_t queued;    /* tasks in the deques           */
+static size_t pending;   /* tasks queued or being done    */
+static pthread_mutex_t idlelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idlewake = PTHREAD_COND_INITIALIZER;
+static int sleepers;
+
+static pthread_mutex_t outlock = PTHREAD_MUTEX_INITIALIZER;
+static int anymatch;
+static int anyerror;
+
+
+static void* xmalloc(size_t size)
+{
+  void* p = malloc(size ? size : 1);
+  if (p == 0)
+  {
+    fprintf(stderr, "tregrep: out of memory\n");
+    exit(2);
+  }
+  return p;
+}
+
+static void failed(const char* path)
+{
+  pthread_mutex_lock(&outlock);
+  fprintf(stderr, "tregrep: %s: %s\n", path, strerror(errno));
+  anyerror = 1;
+  pthread_mutex_unlock(&outlock);
+}
+
+
+/* Task-pool: */
+
+static void push(int self, task_t task)
+{
+  deque_t* deque = &deques[self];
+
+  pthread_mutex_lock(&deque->lock);
+  /* Counted before it can be taken, so a thief can't finish it first and have pending reach 0 or queued wrap */
+  __atomic_fetch_add(&pending, 1, __ATOMIC_SEQ_CST);
+  __atomic_fetch_add(&queued, 1, __ATOMIC_SEQ_CST);
+  if (deque->count == deque->capacity)
+  {
+    size_t capacity = deque->capacity ? 2 * deque->capacity : 64;
+    task_t* tasks = (task_t*) xmalloc(capacity * sizeof(task_t));
+    size_t i;
+
+    for (i = 0; i < deque->count; ++i)
+    {
+      tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+    }
+    free(deque->tasks);
+    deque->tasks = tasks;
+    deque->head = 0;
+    deque->capacity = capacity;
+  }
+  deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+  deque->count += 1;
+  pthread_mutex_unlock(&deque->lock);
+
+  pthread_mutex_lock(&idlelock);
+  if (sleepers > 0)
+  {
+    pthread_cond_signal(&idlewake);
+  }
+  pthread_mutex_unlock(&idlelock);
+}
+
+/* Take a task from the back of deque (the owner's end) or its front (a thief's) */
+static int take(deque_t* deque, int back, task_t* task)
+{
+  int found = 0;
+
+  pthread_mutex_lock(&deque->lock);
+  if (deque->count > 0)
+  {
+    deque->count -= 1;
+    if (back)
+    {
+      *task = deque->tasks[(deque->head + deque->count) % deque->capacity];
+    }
+    else
+    {
+      *task = deque->tasks[deque->head];
+      deque->head = (deque->head + 1) % deque->capacity;
+    }
+    found = 1;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  if (found)
+  {
+    __atomic_fetch_sub(&queued, 1, __ATOMIC_SEQ_CST);
+  }
+  return found;
+}
+
+/* Next task of thread self: its own newest, else the oldest of another thread. Waits while there are none
+   but others are still at work, since they may push more. Returns 0 once all is done. */
+static int next(int self, task_t* task)
+{
+  for (;;)
+  {
+    int i;
+
+    if (take(&deques[self], 1, task))
+    {
+      return 1;
+    }
+    for (i = 1; i < nthreads; ++i)
+    {
+      if (take(&deques[(self + i) % nthreads], 0, task))
+      {
+        return 1;
+      }
+    }
+
+    pthread_mutex_lock(&idlelock);
+    if (__atomic_load_n(&pending, __ATOMIC_SEQ_CST) == 0)
+    {
+      pthread_mutex_unlock(&idlelock);
+      return 0;
+    }
+    if (__atomic_load_n(&queued, __ATOMIC_SEQ_CST) == 0)
+    {
+      sleepers += 1;
+      pthread_cond_wait(&idlewake, &idlelock);
+      sleepers -= 1;
+    }
+    pthread_mutex_unlock(&idlelock);
+  }
+}
+
+/* A task is done: wake everyone up if it was the last, so they can leave */
+static void finish(void)
+{
+  if (__atomic_sub_fetch(&pending, 1, __ATOMIC_SEQ_CST) == 0)
+  {
+    pthread_mutex_lock(&idlelock);
+    pthread_cond_broadcast(&idlewake);
+    pthread_mutex_unlock(&idlelock);
+  }
+}
+
+
+/* Searching: */
+
+static void addhit(piece_t* piece, const hit_t* hit)
+{
+  if (piece->nhits == piece->capacity)
+  {
+    size_t capacity = piece->capacity ? 2 * piece->capacity : 64;
+    hit_t* hits = (hit_t*) xmalloc(capacity * sizeof(hit_t));
+
+    if (piece->nhits > 0)
+    {
+      memcpy(hits, piece->hits, piece->nhits * sizeof(hit_t));
+    }
+    free(piece->hits);
+    piece->hits = hits;
+    piece->capacity = capacity;
+  }
+  piece->hits[piece->nhits++] = *hit;
+}
+
+typedef struct
+{
+  const char*  buf;
+  piece_t*     piece;
+  size_t       counted;  /* offset up to which piece->nlines has counted the newlines */
+} search_t;
+
+static size_t countlines(const char* buf, size_t start, size_t end)
+{
+  size_t n = 0;
+  const char* p = buf + start;
+  const char* stop = buf + end;
+
+  while ((p < stop) && ((p = (const char*) memchr(p, '\n', (size_t) (stop - p))) != 0))
+  {
+    n += 1;
+    p += 1;
+  }
+  return n;
+}
+
+static void found(void* context, size_t linestart, size_t linelength, size_t matchstart, size_t matchlength)
+{
+  search_t* search = (search_t*) context;
+  hit_t hit;
+
+  search->piece->matched += 1;
+  if (countonly || namesonly)
+  {
+    return;
+  }
+  if (numbered)
+  {
+    search->piece->nlines += countlines(search->buf, search->counted, linestart);
+    search->counted = linestart;
+  }
+  hit.linestart = linestart;
+  hit.linelength = linelength;
+  hit.line = search->piece->nlines;
+
+  if (!matchesonly)
+  {
+    hit.matchstart = matchstart;
+    hit.matchlength = matchlength;
+    addhit(search->piece, &hit);
+  }
+  else
+  {
+    /* Every non-empty match of the line */
+    const char* line = search->buf + linestart;
+    int cursor = 0;
+    int start;
+    int length;
+
+    while (re_find_next(pattern, line, (int) linelength, &cursor, &start, &length))
+    {
+      if (length > 0)
+      {
+        hit.matchstart = linestart + (size_t) start;
+        hit.matchlength = (size_t) length;
+        addhit(search->piece, &hit);
+      }
+    }
+  }
+}
+
+static void searchpiece(file_t* file, piece_t* piece)
+{
+  search_t search;
+
+  search.buf = file->map + piece->start;
+  search.piece = piece;
+  search.counted = 0;
+  re_scan_parallel(pattern, search.buf, piece->end - piece->start, 1, found, &search);
+  if (numbered)
+  {
+    piece->nlines += countlines(search.buf, search.counted, piece->end - piece->start);
+  }
+}
+
+static void printfile(file_t* file)
+{
+  size_t matched = 0;
+  size_t line = 1;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < file->npieces; ++i)
+  {
+    matched += file->pieces[i].matched;
+  }
+
+  pthread_mutex_lock(&outlock);
+  if (matched > 0)
+  {
+    anymatch = 1;
+  }
+  if (countonly)
+  {
+    if (prefixed)
+    {
+      printf("%s:", file->path);
+    }
+    printf("%lu\n", (unsigned long) matched);
+  }
+  else if (namesonly)
+  {
+    if (matched > 0)
+    {
+      printf("%s\n", file->path);
+    }
+  }
+  else
+  {
+    for (i = 0; i < file->npieces; ++i)
+    {
+      const piece_t* piece = &file->pieces[i];
+      const char* buf = file->map + piece->start;
+
+      for (j = 0; j < piece->nhits; ++j)
+      {
+        const hit_t* hit = &piece->hits[j];
+
+        if (prefixed)
+        {
+          printf("%s:", file->path);
+        }
+        if (numbered)
+        {
+          printf("%lu:", (unsigned long) (line + hit->line));
+        }
+        if (matchesonly)
+        {
+          fwrite(buf + hit->matchstart, 1, hit->matchlength, stdout);
+        }
+        else
+        {
+          fwrite(buf + hit->linestart, 1, hit->linelength, stdout);
+        }
+        putchar('\n');
+      }
+      line += piece->nlines;
+    }
+  }
+  pthread_mutex_unlock(&outlock);
+}
+
+/* All pieces of file are done: print them and let go of it */
+static void closefile(file_t* file)
+{
+  size_t i;
+
+  printfile(file);
+  for (i = 0; i < file->npieces; ++i)
+  {
+    free(file->pieces[i].hits);
+  }
+  if (file->size > 0)
+  {
+    munmap(file->map, file->size);
+  }
+  free(file->pieces);
+  free(file->path);
+  free(file);
+}
+
+/* Offset of the first line of file that starts at or after offset */
+static size_t linestart(const file_t* file, size_t offset)
+{
+  const char* newline;
+
+  if ((offset == 0) || (offset >= file->size))
+  {
+    return (offset == 0) ? 0 : file->size;
+  }
+  newline = (const char*) memchr(file->map + offset - 1, '\n', file->size - offset + 1);
+  return (newline == 0) ? file->size : (size_t) (newline - file->map) + 1;
+}
+
+static void searchfile(int self, char* path)
+{
+  static char empty[1];
+  file_t* file;
+  struct stat st;
+  size_t i;
+  int fd = open(path, O_RDONLY);
+
+  if ((fd < 0) || (fstat(fd, &st) != 0))
+  {
+    failed(path);
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    free(path);
+    return;
+  }
+
+  file = (file_t*) xmalloc(sizeof(file_t));
+  file->path = path;
+  file->size = (size_t) st.st_size;
+  file->map = empty;
+  if (file->size > 0)
+  {
+    file->map = (char*) mmap(0, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (file->map == MAP_FAILED)
+    {
+      failed(path);
+      close(fd);
+      free(path);
+      free(file);
+      return;
+    }
+  }
+  close(fd);
+
+  /* A large file is cut at lines into pieces that the other threads can steal; this one takes the first */
+  file->npieces = (file->size + PIECE_SIZE - 1) / PIECE_SIZE;
+  if (file->npieces == 0)
+  {
+    file->npieces = 1;
+  }
+  file->pieces = (piece_t*) xmalloc(file->npieces * sizeof(piece_t));
+  memset(file->pieces, 0, file->npieces * sizeof(piece_t));
+  for (i = 0; i < file->npieces; ++i)
+  {
+    file->pieces[i].start = linestart(file, i * PIECE_SIZE);
+    file->pieces[i].end = linestart(file, (i + 1) * PIECE_SIZE);
+  }
+  file->remaining = file->npieces;
+  for (i = file->npieces - 1; i > 0; --i)
+  {
+    task_t task;
+
+    task.type = TASK_PIECE;
+    task.path = 0;
+    task.file = file;
+    task.piece = i;
+    push(self, task);
+  }
+  searchpiece(file, &file->pieces[0]);
+  if (__atomic_sub_fetch(&file->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    closefile(file);
+  }
+}
+
+static void searchdir(int self, char* path)
+{
+  DIR* dir = opendir(path);
+  struct dirent* entry;
+
+  if (dir == 0)
+  {
+    failed(path);
+    free(path);
+    return;
+  }
+  while ((entry = readdir(dir)) != 0)
+  {
+    size_t length = strlen(path);
+    struct stat st;
+    task_t task;
+
+    if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+    {
+      continue;
+    }
+    task.path = (char*) xmalloc(length + strlen(entry->d_name) + 2);
+    strcpy(task.path, path);
+    if ((length == 0) || (path[length - 1] != '/'))
+    {
+      task.path[length++] = '/';
+    }
+    strcpy(task.path + length, entry->d_name);
+    task.file = 0;
+    task.piece = 0;
+
+    /* Symbolic links, devices and the like are left alone, as grep -r does */
+    if (lstat(task.path, &st) != 0)
+    {
+      failed(task.path);
+      free(task.path);
+    }
+    else if (S_ISDIR(st.st_mode))
+    {
+      task.type = TASK_DIR;
+      push(self, task);
+    }
+    else if (S_ISREG(st.st_mode))
+    {
+      task.type = TASK_FILE;
+      push(self, task);
+    }
+    else
+    {
+      free(task.path);
+    }
+  }
+  closedir(dir);
+  free(path);
+}
+
+static void* worker(void* arg)
+{
+  int self = (int) (size_t) arg;
+  task_t task;
+
+  while (next(self, &task))
+  {
+    if (task.type == TASK_DIR)
+    {
+      searchdir(self, task.path);
+    }
+    else if (task.type == TASK_FILE)
+    {
+      searchfile(self, task.path);
+    }
+    else
+    {
+      file_t* file = task.file;
+
+      searchpiece(file, &file->pieces[task.piece]);
+      if (__atomic_sub_fetch(&file->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+      {
+        closefile(file);
+      }
+    }
+    finish();
+  }
+  return 0;
+}
+
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: tregrep [-c] [-l] [-o] [-n] [-j threads] pattern [path ...]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  static char dot[] = ".";
+  static char outbuf[1 << 16];
+  pthread_t threads[MAX_THREADS];
+  int started[MAX_THREADS];
+  void* patternbuf = 0;
+  size_t patternsize;
+  int arg = 1;
+  int i;
+
+  nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  while ((arg < argc) && (argv[arg][0] == '-') && (argv[arg][1] != '\0'))
+  {
+    const char* flag = argv[arg++] + 1;
+
+    if (strcmp(flag, "-") == 0)
+    {
+      break;
+    }
+    for (; *flag != '\0'; ++flag)
+    {
+      switch (*flag)
+      {
+        case 'c': countonly = 1;    break;
+        case 'l': namesonly = 1;    break;
+        case 'o': matchesonly = 1;  break;
+        case 'n': numbered = 1;     break;
+        case 'j':
+        {
+          if (flag[1] != '\0')
+          {
+            nthreads = atoi(flag + 1);
+          }
+          else if (arg < argc)
+          {
+            nthreads = atoi(argv[arg++]);
+          }
+          else
+          {
+            usage();
+          }
+          flag += strlen(flag) - 1;
+        } break;
+        default: usage();
+      }
+    }
+  }
+  if (arg >= argc)
+  {
+    usage();
+  }
+  /* Into a buffer of its own, for patterns longer than the static one of re_compile() holds */
+  patternsize = re_compiled_size(argv[arg]);
+  if (patternsize > 0)
+  {
+    patternbuf = xmalloc(patternsize);
+    pattern = re_compile_into(argv[arg], patternbuf, patternsize);
+  }
+  arg += 1;
+  if (pattern == 0)
+  {
+    fprintf(stderr, "tregrep: invalid pattern '%s'\n", argv[arg - 1]);
+    return 2;
+  }
+  if (nthreads < 1)
+  {
+    nthreads = 1;
+  }
+  if (nthreads > MAX_THREADS)
+  {
+    nthreads = MAX_THREADS;
+  }
+  setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+
+  for (i = 0; i < nthreads; ++i)
+  {
+    pthread_mutex_init(&deques[i].lock, 0);
+  }
+
+  /* The paths given are spread over the threads; names are printed unless it is a single file */
+  prefixed = (argc - arg > 1);
+  for (i = 0; (i < argc - arg) || ((i == 0) && (arg == argc)); ++i)
+  {
+    const char* path = (arg == argc) ? dot : argv[arg + i];
+    struct stat st;
+    task_t task;
+
+    if (stat(path, &st) != 0)
+    {
+      failed(path);
+      continue;
+    }
+    task.path = (char*) xmalloc(strlen(path) + 1);
+    strcpy(task.path, path);
+    task.file = 0;
+    task.piece = 0;
+    task.type = S_ISDIR(st.st_mode) ? TASK_DIR : TASK_FILE;
+    prefixed |= (task.type == TASK_DIR);
+    push(i % nthreads, task);
+  }
+
+  for (i = 1; i < nthreads; ++i)
+  {
+    started[i] = (pthread_create(&threads[i], 0, worker, (void*) (size_t) i) == 0);
+  }
+  worker((void*) 0);
+  for (i = 1; i < nthreads; ++i)
+  {
+    if (started[i])
+    {
+      pthread_join(threads[i], 0);
+    }
+  }
+  fflush(stdout);
+  free(patternbuf);
+
+  return anyerror ? 2 : (anymatch ? 0 : 1);
+}